@@ -13,15 +13,29 @@
  * Driver that receives input of matrices and operator  from user and calculates value 
  * of matrices with that operator
  *
+ * In batch mode (-b) the driver reads a stream of operations from a file, or from the standard
+ * input when no file is given, until it ends. Every operation is given as in the interactive
+ * mode: its number followed by its operand matrices. No prompt is printed and the result of
+ * every operation is written out as soon as it is calculated, so one process runs a whole
+ * workload.
+ *
+ * Usage: IntMatrixMainDriver [-b [file]]
+ *
  * Error handling
  * ~~~~~~~~~~~~~~
  * Driver assumes valid input of matrices as IntMatrix with only ints seperated by commas
  * Driver checks for valid input of operator.
  * Driver checks that matrices fit the given operator inputted.
+ * In batch mode an invalid operator or input that ends inside an operation prints an error and
+ * exits with a failure code, as does a file that cannot be opened.
  ********************************************************************************/
 
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <vector>
 #include "IntMatrix.h"
 
 /*
@@ -40,7 +54,49 @@
  * @def DELIMITER
  * @brief char that seprates inputs of int
  */
-#define DELIMITER ","
+#define DELIMITER ','
+
+/*
+ * @def INPUT_BLOCK
+ * @brief bytes of input read from the stream at a time
+ */
+#define INPUT_BLOCK (1 << 20)
+
+/*
+ * @def INPUT_LOOKAHEAD
+ * @brief bytes kept in the block before parsing a cell, more than any int takes
+ */
+#define INPUT_LOOKAHEAD 64
+
+/*
+ * @def BATCH_FLAG
+ * @brief argument choosing batch mode
+ */
+#define BATCH_FLAG "-b"
+
+/*
+ * @def USAGE
+ * @brief print message for wrong arguments
+ */
+#define USAGE "Usage: IntMatrixMainDriver [-b [file]]"
+
+/*
+ * @def OPEN_ERROR
+ * @brief prints error for a batch file that cannot be opened
+ */
+#define OPEN_ERROR "Error: cannot open batch file "
+
+/*
+ * @def OPERATION_ERROR
+ * @brief prints error for an invalid operator in batch mode
+ */
+#define OPERATION_ERROR "Error: invalid operation "
+
+/*
+ * @def INPUT_ERROR
+ * @brief prints error for batch input that ends inside an operation
+ */
+#define INPUT_ERROR "Error: batch input ended inside an operation."
 
 /*
  * @def ONE_MATRIX
@@ -81,25 +137,25 @@
  * @param operator to print
  * @param number of matrices
  */
-#define MATRIX_PROMPT(op, num) std::cout << "Operation " << op << " requires " << num << " operand"
+#define MATRIX_PROMPT(op, num) gPrompt << "Operation " << op << " requires " << num << " operand"
 
 /*
  * @def GOT_MATRIX
  * @brief Prints message when matrices are received.
  * @param number of matrices
  */
-#define GOT_MATRIX(num) std :: cout << "--------\nGot " << num << " matrix:\n" << std :: endl
+#define GOT_MATRIX(num) gPrompt << "--------\nGot " << num << " matrix:\n" << std :: endl
 
 /*
  * @def GOT_SINGLE_MATRIX
  * @brief Prints message when matrix is received.
  */
-#define GOT_SINGLE_MATRIX std :: cout << "--------\ngot matrix:\n" << std :: endl
+#define GOT_SINGLE_MATRIX gPrompt << "--------\ngot matrix:\n" << std :: endl
 /*
  * @def RESULT_MATRIX
  * @brief message before the final result print
  */
-#define RESULT_MATRIX std :: cout << "==========\nResulted matrix:\n" << std :: endl
+#define RESULT_MATRIX gPrompt << "==========\nResulted matrix:\n" << std :: endl
 
 /*
  * @def MATRIX_PRINT
@@ -117,7 +173,7 @@
  * @def INSERT_MATRIX
  * @brief prompts insertion of matrix
  */
-#define INSERT_MATRIX(num) std :: cout << "Insert " << num << " matrix:" << std :: endl
+#define INSERT_MATRIX(num) gPrompt << "Insert " << num << " matrix:" << std :: endl
 
 /*
  * @def NUM_ROWS
@@ -199,6 +255,268 @@ Each row should be in a separate line."
  */
 #define ADD_NUM 1
 
+/**
+ * @brief Stream of the prompts and of the echoes of the input, muted in batch mode. Results and
+ * errors always go to std :: cout.
+ */
+static std :: ostream gPrompt(std :: cout.rdbuf());
+
+/**
+ * @brief Reads the ints of the input from a stream a block at a time and parses them in place,
+ * without a string or a stream per cell. All the input of the driver is read through one
+ * InputReader, which may hold input read ahead of the matrix being parsed.
+ */
+class InputReader
+{
+public:
+
+    /**
+     * @brief Constructor over a stream
+     * @param stream to read the input from
+     */
+    explicit InputReader(std :: istream &in) : _in(in), _block(INPUT_BLOCK + 1), _cursor(nullptr),
+                                               _end(nullptr), _ended(false), _failed(false)
+    {
+        _cursor = _end = _block.data();
+        *_end = '\0';
+    }
+
+    /**
+     * @brief Checks whether every read so far succeeded
+     * @return true if so, false once a read failed
+     */
+    bool good() const
+    {
+        return !_failed;
+    }
+
+    /**
+     * @brief Marks the input as failed
+     */
+    void fail()
+    {
+        _failed = true;
+    }
+
+    /**
+     * @brief Checks whether only whitespace is left in the input
+     * @return true if the input ended, false otherwise
+     */
+    bool atEnd()
+    {
+        return !_skipSpace();
+    }
+
+    /**
+     * @brief Reads an int separated by whitespace
+     * @param set to the int
+     * @return true if an int was read, false at the end of the input or if it is not an int
+     */
+    bool readInt(int &value)
+    {
+        if(_failed || !_skipSpace())
+        {
+            _failed = true;
+            return false;
+        }
+        _reserve();
+        if(!_parseInt(value))
+        {
+            _failed = true;
+        }
+        return !_failed;
+    }
+
+    /**
+     * @brief Reads the rows of a matrix, each a word of cells ended by a ',' and separated by
+     * whitespace, straight into the cells of the matrix. Like the words read by operator>>,
+     * the cells past the last column are skipped and a cell that is not a number is 0. The
+     * cells missing from a short row are 0, where the stringstream parser repeated the last
+     * cell of the row.
+     * @param the cells in row major order
+     * @param number of rows
+     * @param number of columns
+     * @return true if every row was read, false if the input ended before
+     */
+    bool readRows(int *cells, int rowNum, int colNum)
+    {
+        for(int i = 0; i < rowNum; ++i)
+        {
+            if(_failed || !_skipSpace())
+            {
+                _failed = true;
+                return false;
+            }
+            int *row = cells + (size_t)i * colNum;
+            int j = 0;
+            for(; j < colNum; ++j)
+            {
+                _reserve();
+                if(_isWordEnd(*_cursor))
+                {
+                    break;
+                }
+                _parseInt(row[j]);
+                // skip whatever follows the number up to the end of the cell
+                while(*_cursor != DELIMITER && !_isWordEnd(*_cursor))
+                {
+                    if(++_cursor == _end)
+                    {
+                        _reserve();
+                    }
+                }
+                if(*_cursor == DELIMITER)
+                {
+                    ++_cursor;
+                }
+            }
+            std :: fill(row + j, row + colNum, 0);
+            // skip the cells past the last column
+            do
+            {
+                while(!_isWordEnd(*_cursor))
+                {
+                    ++_cursor;
+                }
+            }
+            while(_cursor == _end && _refill());
+        }
+        return true;
+    }
+
+private:
+
+    /**
+     * @brief Checks whether a char separates words
+     * @param the char, '\0' past the end of the block
+     * @return true if it is whitespace or '\0', false otherwise
+     */
+    static bool _isWordEnd(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f' ||
+               c == '\0';
+    }
+
+    /**
+     * @brief Parses an optional sign and digits at the cursor, clamping like operator>>
+     * @param set to the int, 0 if there are no digits
+     * @return true if there were digits, false otherwise
+     */
+    bool _parseInt(int &value)
+    {
+        const bool negative = *_cursor == '-';
+        if(negative || *_cursor == '+')
+        {
+            ++_cursor;
+        }
+        // the magnitude of the most negative int is one more than the largest
+        const unsigned long long limit = negative ? (unsigned long long)INT_MAX + 1 : INT_MAX;
+        unsigned long long magnitude = 0;
+        const char *digits = _cursor;
+        while(*_cursor >= '0' && *_cursor <= '9')
+        {
+            magnitude = magnitude * 10 + (*_cursor++ - '0');
+            if(magnitude > limit)
+            {
+                magnitude = limit;
+            }
+            if(_cursor == _end)
+            {
+                // the block is moved, only the digits still to parse matter
+                _reserve();
+                digits = nullptr;
+            }
+        }
+        value = negative ? (int)(0 - magnitude) : (int)magnitude;
+        return digits != _cursor;
+    }
+
+    /**
+     * @brief Skips whitespace, reading more input when the block runs out
+     * @return true if a word follows, false at the end of the input
+     */
+    bool _skipSpace()
+    {
+        while(true)
+        {
+            while(_cursor < _end && _isWordEnd(*_cursor))
+            {
+                ++_cursor;
+            }
+            if(_cursor < _end)
+            {
+                return true;
+            }
+            if(!_refill())
+            {
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief Reads more input when fewer than INPUT_LOOKAHEAD bytes are left in the block, so a
+     * whole cell can be parsed without checking for the end of the block
+     */
+    void _reserve()
+    {
+        while(_end - _cursor < INPUT_LOOKAHEAD && _refill())
+        {
+        }
+    }
+
+    /**
+     * @brief Moves the bytes not yet parsed to the start of the block and reads more after them.
+     * Only the first byte is waited for, the rest is what the stream holds already, so a user
+     * typing the input is never waited on for a whole block.
+     * @return true if more input was read, false at the end of the input
+     */
+    bool _refill()
+    {
+        if(_ended)
+        {
+            return false;
+        }
+        const size_t left = _end - _cursor;
+        std :: memmove(_block.data(), _cursor, left);
+        _cursor = _block.data();
+        _end = _cursor + left;
+        *_end = '\0';
+        const size_t room = INPUT_BLOCK - left;
+        if(room == 0)
+        {
+            return false;
+        }
+        // like operator>>, show the prompts before waiting for input
+        if(_in.tie() != nullptr)
+        {
+            _in.tie()->flush();
+        }
+        std :: streambuf *buffer = _in.rdbuf();
+        const int first = buffer->sbumpc();
+        if(first == std :: char_traits<char> :: eof())
+        {
+            _ended = true;
+            return false;
+        }
+        *_end++ = (char)first;
+        const std :: streamsize held = buffer->in_avail();
+        if(held > 0)
+        {
+            _end += buffer->sgetn(_end, std :: min<std :: streamsize>(held, room - 1));
+        }
+        *_end = '\0';
+        return true;
+    }
+
+    std :: istream &_in; /**< The stream read. */
+    std :: vector<char> _block; /**< Input read and not yet parsed, ended by a '\0'. */
+    char *_cursor; /**< Next byte to parse. */
+    char *_end; /**< One past the last byte read. */
+    bool _ended; /**< Whether the stream ended. */
+    bool _failed; /**< Whether a read failed. */
+};
+
 /**
  * @brief Checks whether the input of operand number was legal
  * @param int input to check
@@ -270,11 +588,11 @@ static void printMatrixMessage(int num, std::string op)
     MATRIX_PROMPT(op, num);
     if (num == ONE_MATRIX)
     {
-        std :: cout << MATRIX_PRINT << std :: endl;
+        gPrompt << MATRIX_PRINT << std :: endl;
     }
     else
     {
-        std :: cout << TWO_MATRIX_PRINT << std :: endl;
+        gPrompt << TWO_MATRIX_PRINT << std :: endl;
     }
 }
 
@@ -316,42 +634,26 @@ int matrixInputPrompt(int input)
 
 /**
  * @brief Receives matrix input from user
- * @return new IntMatrix object
+ * @param reader of the input
+ * @return new IntMatrix object, empty if the input ended before the dimensions
  */
-IntMatrix getMatrixInput()
+IntMatrix getMatrixInput(InputReader &in)
 {
     // get the row and col dimensions from the user
-    int rowNum, colNum;
-    std :: cout << NUM_ROWS;
-    std :: cin >> rowNum;
-    std :: cout << NUM_COLS;
-    std :: cin >> colNum;
-    // initialize an array of that size
-    int *matrix = new int[rowNum * colNum];
-    // receive the values to put in that array from the user
-    std :: cout << EXPLAIN << std :: endl;
-    for(int i = 0; i < rowNum; i++)
+    int rowNum = 0, colNum = 0;
+    gPrompt << NUM_ROWS;
+    in.readInt(rowNum);
+    gPrompt << NUM_COLS;
+    in.readInt(colNum);
+    if(!in.good() || rowNum < 0 || colNum < 0)
     {
-        std :: string currentLine;
-        std :: string token;
-        // receive a line, then use find and substr to get each int from that line
-        std :: cin >> currentLine;
-        size_t position = 0;
-        for (int j = 0; j < colNum; j++)
-        {
-            position = currentLine.find(DELIMITER);
-            token = currentLine.substr(0, position);
-            currentLine.erase(0, position + 1);
-            // insert the int value into the proper index in the array
-            std :: stringstream currentStream(token);
-            int current = 0;
-            currentStream >> current;
-            matrix[(i * colNum) + j] = current;
-        }
+        in.fail();
+        return IntMatrix();
     }
-    // use our constructor from an array and row/col dimensions to create a new object
-    IntMatrix intMatrix(rowNum, colNum, matrix);
-    delete[] matrix;
+    // receive the values from the user straight into the array of a matrix of that size
+    gPrompt << EXPLAIN << std :: endl;
+    IntMatrix intMatrix(rowNum, colNum);
+    in.readRows(intMatrix.getArr(), rowNum, colNum);
     return intMatrix;
 }
 
@@ -369,7 +671,7 @@ void calculateOneMatrix(int op, IntMatrix &intMatrix)
         }
         else
         {
-            std :: cout << TRACE_MESSAGE << intMatrix.trace() << std :: endl;
+            std :: cout << TRACE_MESSAGE << intMatrix.trace() << '\n';
         }
     }
     else
@@ -377,7 +679,7 @@ void calculateOneMatrix(int op, IntMatrix &intMatrix)
         // if the operator was trans, calculate
         IntMatrix tempMatrix = intMatrix.trans();
         RESULT_MATRIX;
-        std :: cout << tempMatrix << std :: endl;
+        std :: cout << tempMatrix << '\n';
     }
 }
 
@@ -430,7 +732,7 @@ void calculateTwoMatrices(int op, IntMatrix &first, IntMatrix &second)
     if(!error)
     {// print the matrix we calculated
         RESULT_MATRIX;
-        std :: cout << tempMatrix << std :: endl;
+        std :: cout << tempMatrix << '\n';
     }
 }
 
@@ -442,20 +744,16 @@ void calculateTwoMatrices(int op, IntMatrix &first, IntMatrix &second)
 void printInputtedMatrix(std :: string num, const IntMatrix& matrix) 
 {
     GOT_MATRIX(num);
-    std :: cout << matrix << std :: endl;
+    gPrompt << matrix << std :: endl;
 }
 /**
- * @brief Main that deals with management of program, calls all functions
+ * @brief Receives the operand matrices of an operation and prints its result
+ * @param number of the operation
+ * @param reader of the matrices
+ * @return true if the operation was calculated, false if the input ended inside it
  */
-int main()
+bool runOperation(int operandChoice, InputReader &in)
 {
-    int operandChoice;
-    // print the prompt and get the user's input for the operand
-    do
-    {
-        std :: cout << OP_PRINT_PROMPT << std :: endl;
-        std :: cin >> operandChoice;
-    }while(!inputCheck(operandChoice));
     // print the matrix prompt
     int numMatrix = matrixInputPrompt(operandChoice);
     // if needed get two matrices and calculate the result
@@ -463,9 +761,13 @@ int main()
     {
         // get the first matrix from user
         INSERT_MATRIX(FIRST);
-        IntMatrix firstMatrix = getMatrixInput();
+        IntMatrix firstMatrix = getMatrixInput(in);
         INSERT_MATRIX(SECOND);
-        IntMatrix secondMatrix = getMatrixInput();
+        IntMatrix secondMatrix = getMatrixInput(in);
+        if(!in.good())
+        {
+            return false;
+        }
         printInputtedMatrix(FIRST, firstMatrix);
         printInputtedMatrix(SECOND, secondMatrix);
         calculateTwoMatrices(operandChoice, firstMatrix, secondMatrix);
@@ -473,10 +775,92 @@ int main()
     // otherwise calculate just the first matrix
     else
     {
-        IntMatrix firstMatrix = getMatrixInput();
+        IntMatrix firstMatrix = getMatrixInput(in);
+        if(!in.good())
+        {
+            return false;
+        }
         GOT_SINGLE_MATRIX;
-        std :: cout << firstMatrix << std :: endl;
+        gPrompt << firstMatrix << std :: endl;
         calculateOneMatrix(operandChoice, firstMatrix);
     }
+    return true;
+}
+
+/**
+ * @brief Runs every operation of a stream without prompts until the stream ends
+ * @param stream of operations
+ * @return EXIT_SUCCESS if every operation was calculated, EXIT_FAILURE otherwise
+ */
+int runBatch(std :: istream &stream)
+{
+    // nothing is prompted, so there is no need to flush the results before every read
+    gPrompt.rdbuf(nullptr);
+    stream.tie(nullptr);
+    InputReader in(stream);
+    int operandChoice;
+    while(!in.atEnd() && in.readInt(operandChoice))
+    {
+        if(!inputCheck(operandChoice))
+        {
+            std :: cout << OPERATION_ERROR << operandChoice << std :: endl;
+            return EXIT_FAILURE;
+        }
+        if(!runOperation(operandChoice, in))
+        {
+            std :: cout << INPUT_ERROR << std :: endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // a stream that ended anywhere but between operations was not all read
+    if(!in.good())
+    {
+        std :: cout << INPUT_ERROR << std :: endl;
+        return EXIT_FAILURE;
+    }
+    std :: cout.flush();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Main that deals with management of program, calls all functions
+ * @param number of arguments
+ * @param -b for batch mode, optionally followed by the file of operations
+ * @return 0 on success, EXIT_FAILURE on wrong arguments or a failed batch
+ */
+int main(int argc, char *argv[])
+{
+    if(argc > 1)
+    {
+        if(argc > 3 || std :: strcmp(argv[1], BATCH_FLAG) != 0)
+        {
+            std :: cerr << USAGE << std :: endl;
+            return EXIT_FAILURE;
+        }
+        std :: ios :: sync_with_stdio(false);
+        if(argc == 2)
+        {
+            return runBatch(std :: cin);
+        }
+        std :: ifstream batch(argv[2]);
+        if(!batch)
+        {
+            std :: cout << OPEN_ERROR << argv[2] << std :: endl;
+            return EXIT_FAILURE;
+        }
+        return runBatch(batch);
+    }
+    InputReader in(std :: cin);
+    int operandChoice = 0;
+    // print the prompt and get the user's input for the operand
+    do
+    {
+        gPrompt << OP_PRINT_PROMPT << std :: endl;
+        if(!in.readInt(operandChoice))
+        {
+            return 0;
+        }
+    }while(!inputCheck(operandChoice));
+    runOperation(operandChoice, in);
     return 0;
 }
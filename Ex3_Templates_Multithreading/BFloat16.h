@@ -0,0 +1,121 @@
+/********************************************************************************
+ * @file BFloat16.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard BFloat16 header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard BFloat16 header.
+ *
+ * A 16 bit floating point number made of the upper half of a float: the same sign and 8 bit
+ * exponent, and 7 bits of mantissa. It has the range of a float at half the bytes, so a
+ * Matrix<BFloat16> moves half the memory of a Matrix<float>. Arithmetic is done in float and
+ * rounded back to the nearest BFloat16, ties to even.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * None, like a float it holds infinities and NaN.
+ ********************************************************************************/
+
+#ifndef BFLOAT16_H
+#define BFLOAT16_H
+
+#include <cstdint>
+#include <cstring>
+
+/*
+ * @def BFLOAT16_NAN
+ * @brief bits of the quiet NaN a NaN float is rounded to
+ */
+#define BFLOAT16_NAN 0x7FC0
+
+/**
+ * @brief The upper 16 bits of a float
+ */
+class BFloat16
+{
+public:
+
+	/**
+	 * @brief Default constructor, leaves the bits unwritten like a float
+	 */
+	BFloat16() = default;
+
+	/**
+	 * @brief A constructor rounding a float to the nearest BFloat16, ties to even
+	 * @param the float
+	 */
+	BFloat16(float value)
+	{
+		uint32_t bits;
+		std :: memcpy(&bits, &value, sizeof(bits));
+		if((bits & 0x7FFFFFFF) > 0x7F800000)
+		{
+			_bits = BFLOAT16_NAN;
+			return;
+		}
+		_bits = (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+	}
+
+	/**
+	 * @brief Converts to the float holding the same number
+	 * @return the float
+	 */
+	operator float() const
+	{
+		const uint32_t bits = (uint32_t)_bits << 16;
+		float value;
+		std :: memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	/**
+	 * @brief Overrides += operator to add a number and round the sum
+	 * @param the number
+	 * @return reference to the current number
+	 */
+	BFloat16& operator+=(BFloat16 other)
+	{
+		return *this = BFloat16((float)*this + (float)other);
+	}
+
+	/**
+	 * @brief Overrides -= operator to subtract a number and round the difference
+	 * @param the number
+	 * @return reference to the current number
+	 */
+	BFloat16& operator-=(BFloat16 other)
+	{
+		return *this = BFloat16((float)*this - (float)other);
+	}
+
+	/**
+	 * @brief Overrides *= operator to multiply by a number and round the product
+	 * @param the number
+	 * @return reference to the current number
+	 */
+	BFloat16& operator*=(BFloat16 other)
+	{
+		return *this = BFloat16((float)*this * (float)other);
+	}
+
+	/**
+	 * @brief Getter for the 16 bits of the number
+	 * @return the bits
+	 */
+	inline uint16_t bits() const
+	{
+		return _bits;
+	}
+
+private:
+
+	uint16_t _bits; /**< Sign, exponent and upper 7 bits of the mantissa of a float. */
+};
+
+#endif
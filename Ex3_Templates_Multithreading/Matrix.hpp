@@ -16,6 +16,36 @@
  *
  * The header provides the following features:
  *  - basic matrix operations
+ *  - saving to and memory mapping from a binary matrix file, or a POSIX shared memory object
+ *    other processes map read only (see MatrixServer.hpp)
+ *  - reading and writing TSV and CSV text without streams, parsed in parallel pieces
+ *  - out of core multiplication of matrix files larger than memory
+ *  - asynchronous operations on a shared thread pool, returning chainable futures
+ *  - opt in tracing of every operation (compile with -DMATRIX_TRACE, see MatrixTrace.h)
+ *  - opt in hardware counters of every kernel (compile with -DMATRIX_PERF, see MatrixPerf.h)
+ *  - opt in accounting of the memory of the cells per element type, with a high water mark,
+ *    scoped reports and a limit past which allocations throw std :: bad_alloc (compile with
+ *    -DMATRIX_MEMORY, see MatrixMemory.h)
+ *  - blocked kernels whose tile sizes and parallel thresholds are read from a tuning profile
+ *  - parallel map, zip and reduce over the cells with callables, and scalar broadcast operators
+ *  - sum, Frobenius norm, largest magnitude and row and column sums reduced by pairwise trees
+ *    of a fixed shape, reproducible bit for bit whatever the threads and the layout
+ *  - row major, column major and tiled storage layouts with kernels specialized for each, and a
+ *    transpose in place that only reinterprets the layout
+ *  - opt in copy on write, copies sharing their cells until one of them writes (setShared)
+ *  - multiplications summing the products in a wider accumulator type than the cells
+ *    (MatrixAccumulator), so narrow cells neither overflow nor lose precision
+ *  - small matrices keep their cells inside the object, without a heap allocation, and run
+ *    their kernels without dispatching threads
+ *  - parallel comparisons that stop every thread at the first difference, approximate
+ *    comparison (allClose) and a content hash
+ *  - in place rank one and rank k updates, outer and Kronecker products written straight into
+ *    their destination
+ *  - cancellation tokens and deadlines, checked by the kernels between blocks of rows
+ *    (MatrixCancellation :: Scope, see MatrixCancel.h)
+ *  - NUMA aware parallel kernels: with the pool pinned (setPlacement or MATRIX_PLACEMENT) every
+ *    worker gets the same block of rows on every call, and writes the result rows of its block
+ *    first, so they are placed on its node
  *
  * Error handling
  * ~~~~~~~~~~~~~~
@@ -26,11 +56,33 @@
 #define MATRIX_H
 
 #include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
 #include <thread>
 #include <exception>
+#include <type_traits>
 #include "BadDimensionException.h"
+#include "BFloat16.h"
 #include "Complex.h"
+#include "MatrixAllocator.h"
+#include "MatrixCancel.h"
+#include "MatrixFile.h"
+#include "MatrixText.h"
+#include "MatrixOutOfCore.hpp"
+#include "MatrixFuture.hpp"
+#include "MatrixMemory.h"
+#include "MatrixTrace.h"
+#include "MatrixPerf.h"
+#include "MatrixTuning.h"
+#include "ThreadPool.h"
 
 /*
  * @def DEF_VALUE
@@ -107,15 +159,136 @@
  */
 #define INDEX_MESSAGE "Index chosen is not in matrix bound."
 
+/*
+ * @def WRITE_FILE_MESSAGE
+ * @brief print message for a matrix file that could not be written
+ */
+#define WRITE_FILE_MESSAGE "Cannot write matrix file: "
+
+/*
+ * @def SAME_FILE_SAVE_MESSAGE
+ * @brief print message for saving a mapped matrix over the file its cells are mapped from
+ */
+#define SAME_FILE_SAVE_MESSAGE "Cannot save a mapped matrix over its own file: "
+
+/**
+ * @def CHUNK_CELLS
+ * @brief the least number of cell operations worth handing to a pool thread as one chunk
+ */
+#define CHUNK_CELLS 4096
+
+/*
+ * @def PAIRWISE_BASE
+ * @brief most values a pairwise reduction folds in order before splitting them in halves
+ */
+#define PAIRWISE_BASE 8
+
+/*
+ * @def COMPARE_BLOCK
+ * @brief cells compared between two checks of whether another thread found a difference
+ */
+#define COMPARE_BLOCK 1024
+
+/*
+ * @def HASH_GOLDEN
+ * @brief odd constant the position of a cell is multiplied by before its hash is mixed
+ */
+#define HASH_GOLDEN 0x9E3779B97F4A7C15ULL
+
+/**
+ * @def MATRIX_INLINE_CELLS
+ * @brief most cells a matrix keeps inside the object instead of on the heap, may be set with -D
+ */
+#ifndef MATRIX_INLINE_CELLS
+#define MATRIX_INLINE_CELLS 16
+#endif
+
+/**
+ * @def LAYOUT_TILE
+ * @brief side of the square tiles of the tiled layout
+ */
+#define LAYOUT_TILE 32
+
 /**
  * @def OFFSET
  * @brief an offset for when we loop through the matrix. Since () operator is 1 based, not zero.
  */
 #define OFFSET 1
 
+/**
+ * @brief Order the cells of a Matrix are stored in
+ */
+enum MatrixLayout
+{
+	LAYOUT_ROW_MAJOR, /**< Row after row, the order of vectors, files and iterators. */
+	LAYOUT_COL_MAJOR, /**< Column after column, the row major order of the transpose. */
+	LAYOUT_TILED /**< Row major LAYOUT_TILE square tiles, each stored row major. */
+};
+
+/**
+ * @brief Type the widening multiplications of a Matrix<T> sum the products of its cells in, T
+ * itself unless specialized below
+ */
+template <typename T>
+struct MatrixAccumulator
+{
+	typedef T type;
+};
+
+template <>
+struct MatrixAccumulator<int8_t>
+{
+	typedef int32_t type;
+};
+
+template <>
+struct MatrixAccumulator<int16_t>
+{
+	typedef int32_t type;
+};
+
+template <>
+struct MatrixAccumulator<int32_t>
+{
+	typedef int64_t type;
+};
+
+template <>
+struct MatrixAccumulator<uint32_t>
+{
+	typedef uint64_t type;
+};
+
+template <>
+struct MatrixAccumulator<float>
+{
+	typedef double type;
+};
+
+template <>
+struct MatrixAccumulator<BFloat16>
+{
+	typedef float type;
+};
+
+template <typename Q>
+class QuantizedMatrix;
+
 template <typename T>
 class Matrix
 {
+
+	/**
+	 * @brief Quantized matrices run their kernels through ours and write our cells directly
+	 */
+	template <typename Q>
+	friend class QuantizedMatrix;
+
+	/**
+	 * @brief Widening multiplications build matrices of other element types
+	 */
+	template <typename U>
+	friend class Matrix;
 	
 	/**
 	 * @brief Overrides << operator for Matrix to print a matrix.
@@ -125,6 +298,16 @@ class Matrix
 	 */
 	template<typename U>
 	friend std::ostream& operator<< (std::ostream& os, const Matrix<U>& ourMatrix);
+
+	/**
+	 * @brief Overrides >> operator for Matrix to read a matrix, a row per line up to a blank line
+	 * or the end of the stream.
+	 * @param stream to read from
+	 * @param Matrix to set
+	 * @return the stream, failed if it held no matrix
+	 */
+	template<typename U>
+	friend std :: istream& operator>> (std :: istream& is, Matrix<U>& ourMatrix);
 	
 	/**
 	 * @brief Deep copy swaps between two matrixes
@@ -139,374 +322,2437 @@ private:
 
 	unsigned int _rowNum; /**< Row Dimension of IntMatrix. */
 	unsigned int _colNum; /**< Column Dimension of IntMatrix. */
-	std :: vector<T> _matrix; /** vector of T which represents the matrix */
+	std :: vector<T, MatrixAllocator<T>> _matrix; /** vector of T which represents the matrix */
+	T _inline[MATRIX_INLINE_CELLS]; /**< The cells of a matrix small enough to keep them here. */
+	static_assert(MATRIX_INLINE_CELLS >= DEF_SIZE, "the default matrix must fit inline");
+	std :: shared_ptr<const MappedMatrixFile> _mapping; /**< File holding the cells, if mapped. */
+	std :: shared_ptr<std :: vector<T, MatrixAllocator<T>>> _shared; /**< Cells shared by copies. */
+	MatrixLayout _layout; /**< Order of the cells in _matrix or in the mapped file. */
 	static bool _parallel; /**<Static variable that holds whether we are running in parallel. */
-	
+	static bool _sharing; /**< Whether new cells are put in buffers shared by copies. */
+
 	/**
-	 * @brief Setter for the row dimension of IntMatrix
-	 * @param new row dimension
+	 * @brief Tag of the constructor that leaves the cells unwritten
 	 */
-	inline void _setRow(unsigned int rowAmnt)
+	struct _Uninitialized
 	{
-		_rowNum = rowAmnt;
-	}
-	
+	};
+
 	/**
-	 * @brief Setter for the column dimension of IntMatrix
-	 * @param new column dimension
+	 * @brief A constructor which receives the dimensions and allocates cells without writing them,
+	 * for results whose every cell a kernel writes. Cells of plain numbers hold garbage until
+	 * then, and their pages are placed on the node of the thread that writes them first.
+	 * @param row dimension
+	 * @param column dimension
 	 */
-	inline void _setCol(unsigned int colAmnt)
-	{
-		_colNum = colAmnt;
-	}
-	
-public:
-	
-    /**
-     * @brief A default constructor which receives no values.
-     */
-	Matrix<T>(): _rowNum(DEF_SIZE), _colNum(DEF_SIZE)
+	Matrix<T>(unsigned int rowAmnt, unsigned int colAmnt, _Uninitialized) :
+		_rowNum(rowAmnt), _colNum(colAmnt), _layout(LAYOUT_ROW_MAJOR)
 	{
+		if((!rows())^(!cols()))
+		{
+			throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+		}
+		if(_isInline())
+		{
+			return;
+		}
 		try
 		{
-			// intiialize a matrix with default values
-			_matrix.push_back(DEF_VALUE);
+			_matrix.resize((size_t)rowAmnt * colAmnt);
+			MATRIX_TRACE_ALLOC();
+			_adopt();
 		}
-		catch(std ::bad_alloc &e)
+		catch (std :: bad_alloc &e)
 		{
-			// The forum reply was inconclusive as to whether to print a message or just throw an exception so I did both
 			BAD_ALLOC_PRINT;
 			throw;
 		}
 	}
-    
-    /**
-     * @brief A copy constructor which receives an IntMatrix object and deep copies it.
-     * @param An Matrix object to be copied.
-     */
-	Matrix<T>(const Matrix<T> &copyMatrix) : Matrix<T> (copyMatrix.rows(), 
-											 copyMatrix.cols(),
-											 copyMatrix._matrix)
+
+	/**
+	 * @brief Getter for the cells of the matrix, wherever they live
+	 * @return pointer to the first cell in row major order
+	 */
+	inline const T *_data() const
 	{
+		return _mapping ? _mapping->cells<T>() : _shared ? _shared->data() :
+			   _isInline() ? _inline : _matrix.data();
+	}
 
+	/**
+	 * @brief Checks whether our cells are few enough to be kept inside the object. Mapped cells
+	 * stay in their file whatever their number.
+	 * @return true if the cells are in _inline, false otherwise
+	 */
+	inline bool _isInline() const
+	{
+		return (size_t)rows() * cols() <= MATRIX_INLINE_CELLS && !_mapping;
 	}
-	
 
 	/**
-	 * @brief A copy constructor which receives an IntMatrix object and deep copies it.
-	 * @param An Matrix object to be copied.
+	 * @brief Getter for the cells of the matrix for writing. A matrix that is mapped from a file
+	 * first copies its cells into its own vector, the file itself is never written, and a matrix
+	 * sharing its cells with copies first copies them into a buffer of its own.
+	 * @return pointer to the first cell in row major order
 	 */
-	Matrix<T>(const Matrix<T> && copyMatrix) : _rowNum(copyMatrix.rows()),
-											  _colNum(copyMatrix.cols()),
-											  _matrix(std :: move(copyMatrix._matrix))
+	inline T *_mutableData()
 	{
+		if(_mapping)
+		{
+			_detach();
+		}
+		if(_shared && _shared.use_count() != 1)
+		{
+			_unshare();
+		}
+		return _shared ? _shared->data() : _isInline() ? _inline : _matrix.data();
 	}
-	
-    /**
-     * @brief A constructor which receives the dimensions of the matrix and an array and creates a
-     * new Matrix
-     * @param row dimension
-     * @param column dimension
-     * @param array of ints
-     */
-	Matrix<T> (unsigned int row, unsigned int col, const std :: vector<T>& cells): _rowNum(row),
-																				_colNum(col)
+
+	/**
+	 * @brief Getter for the cells of the matrix for writing through a pointer or reference that
+	 * outlives the call. Our cells are taken out of sharing first, so a later copy copies them
+	 * instead of seeing the writes made through it. Like the leaked strings of copy on write
+	 * strings, the cells stay unshared from then on.
+	 * @return pointer to the first cell in row major order
+	 */
+	T *_leakedData()
 	{
-		// if the size does not match the dimension throw an exception, otherwise set vector
-		if(row * col != cells.size() || ((!rows())^(!cols())))
+		T *cells = _mutableData();
+		if(_shared)
 		{
-			   throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+			// the buffer is ours alone by now, and swapping keeps the cells where they are
+			_matrix.swap(*_shared);
+			_shared.reset();
 		}
-		try 
+		return cells;
+	}
+
+	/**
+	 * @brief In shared mode, moves our cells into a buffer that copies can share. Inline cells are
+	 * cheaper to copy than to share and stay where they are.
+	 */
+	void _adopt()
+	{
+		if(_sharing && !_isInline())
 		{
-			// copy each object from the vector into our Matrix's vector
-			for(unsigned int i = 0; i < cells.size(); ++i)
-			{
-				_matrix.push_back(cells[i]);
-			}
+			_shared = std :: make_shared<std :: vector<T, MatrixAllocator<T>>>(std :: move(_matrix));
+			_matrix.clear();
+		}
+	}
+
+	/**
+	 * @brief Copies the cells we share with copies into a buffer of our own
+	 */
+	void _unshare()
+	{
+		try
+		{
+			_shared = std :: make_shared<std :: vector<T, MatrixAllocator<T>>>(*_shared);
+			MATRIX_TRACE_ALLOC();
 		}
 		catch (std :: bad_alloc &e)
 		{
-			// The forum reply was inconclusive as to whether to print a message or just throw an exception so I did both
 			BAD_ALLOC_PRINT;
 			throw;
 		}
-
 	}
-	
-    /**
-     * @brief A constructor which receives the dimensions and creates a new empty Matrix
-     * @param row dimension
-     * @param column dimension
-     */
-	Matrix<T>(unsigned int rowAmnt, unsigned int colAmnt): _rowNum(rowAmnt), _colNum(colAmnt)
+
+	/**
+	 * @brief Copies the cells of a mapped matrix into our vector and drops the mapping
+	 */
+	void _detach()
 	{
-		// if the size does not match the dimension throw an exception, otherwise set vector
-		if((!rows())^(!cols()))
+		const T *cells = _mapping->cells<T>();
+		const size_t cellAmnt = (size_t)rows() * cols();
+		if(cellAmnt <= MATRIX_INLINE_CELLS)
 		{
-			   throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+			std :: copy(cells, cells + cellAmnt, _inline);
+			_mapping.reset();
+			return;
 		}
-		// set a new vector of proper size full of 0s
-		for(unsigned int i = 0; i < rowAmnt; ++i)
+		try
 		{
-			for(unsigned int j = 0; j < colAmnt; ++j)
-			{
-				_matrix.push_back(T(DEF_VALUE));
-			}
+			_matrix.assign(cells, cells + cellAmnt);
+			MATRIX_TRACE_ALLOC();
+			_adopt();
+		}
+		catch (std :: bad_alloc &e)
+		{
+			BAD_ALLOC_PRINT;
+			throw;
+		}
+		_mapping.reset();
+	}
+
+	/**
+	 * @brief Refuses to write a mapped matrix over the file it is mapped from, which is truncated
+	 * before its cells are read
+	 * @param path of the file to write
+	 */
+	void _checkNotMappedFrom(const std :: string& path) const
+	{
+		if(_mapping && _mapping->isFile(path))
+		{
+			throw std :: invalid_argument(SAME_FILE_SAVE_MESSAGE + path);
 		}
 	}
 	
+	/**
+	 * @brief Setter for the row dimension of IntMatrix
+	 * @param new row dimension
+	 */
+	inline void _setRow(unsigned int rowAmnt)
+	{
+		_rowNum = rowAmnt;
+	}
 	
-	static void setParallel(bool val)
+	/**
+	 * @brief Setter for the column dimension of IntMatrix
+	 * @param new column dimension
+	 */
+	inline void _setCol(unsigned int colAmnt)
 	{
-		// if the value should change
-		if(val != _parallel)
+		_colNum = colAmnt;
+	}
+
+	/**
+	 * @brief Number of threads an operation is split between in the current mode
+	 * @return the number of threads
+	 */
+	static unsigned int _threadsUsed()
+	{
+		return _parallel ? ThreadPool :: shared().size() + 1 : 1;
+	}
+
+	/**
+	 * @brief Position of a cell in the storage of a layout
+	 * @param the layout
+	 * @param row dimension
+	 * @param column dimension
+	 * @param zero based row of the cell
+	 * @param zero based column of the cell
+	 * @return the index of the cell in the storage
+	 */
+	static size_t _cellIndex(MatrixLayout layout, size_t rowAmnt, size_t colAmnt, size_t row,
+							 size_t col)
+	{
+		switch(layout)
 		{
-			// then change it and print appropriate message
-			_parallel = val;
-			if(val == true)
-			{
-				PAR_MACRO(PARALLEL);
-			}
-			else
+			case LAYOUT_COL_MAJOR:
+				return col * rowAmnt + row;
+			case LAYOUT_TILED:
 			{
-				PAR_MACRO(NON_PARALLEL);
+				// whole bands of tiles come before our band, and whole tiles of our band before
+				// our tile, the tiles of the last band and column being cut short
+				const size_t band = row / LAYOUT_TILE * LAYOUT_TILE;
+				const size_t first = col / LAYOUT_TILE * LAYOUT_TILE;
+				const size_t height = std :: min<size_t>(LAYOUT_TILE, rowAmnt - band);
+				const size_t width = std :: min<size_t>(LAYOUT_TILE, colAmnt - first);
+				return band * colAmnt + first * height + (row - band) * width + col - first;
 			}
+			default:
+				return row * colAmnt + col;
 		}
 	}
-	
+
 	/**
-	 * @brief Getter for the row dimension of the IntMatrix.
-	 * @return Int row dimension
+	 * @brief Position of one of our cells in our storage
+	 * @param zero based row of the cell
+	 * @param zero based column of the cell
+	 * @return the index of the cell in the storage
 	 */
-	inline unsigned int rows() const
+	inline size_t _index(size_t row, size_t col) const
 	{
-		return _rowNum;
+		return _layout == LAYOUT_ROW_MAJOR ? row * cols() + col :
+											 _cellIndex(_layout, rows(), cols(), row, col);
 	}
-	
+
 	/**
-	 * @brief Getter for the column dimension of the IntMatrix.
-	 * @return Column dimension
+	 * @brief Writes our cells into a buffer in another layout, a band of LAYOUT_TILE rows at a
+	 * time so the cells read and written stay in cache, the bands split between the pool threads
+	 * in parallel mode.
+	 * @param buffer of rows() x cols() cells
+	 * @param the layout to write
 	 */
-	inline unsigned int cols() const
+	void _convertInto(T *out, MatrixLayout layout) const
 	{
-		return _colNum;
+		const T *in = _data();
+		const MatrixLayout from = _layout;
+		const size_t rowAmnt = rows();
+		const size_t colAmnt = cols();
+		_forEachRow(_tuning(KERNEL_TRANS), "toLayout", rowAmnt * colAmnt,
+					(rowAmnt + LAYOUT_TILE - 1) / LAYOUT_TILE, (size_t)LAYOUT_TILE * colAmnt,
+					[=](size_t firstBand, size_t lastBand)
+		{
+			const size_t lastRow = std :: min(lastBand * LAYOUT_TILE, rowAmnt);
+			for(size_t jj = 0; jj < colAmnt; jj += LAYOUT_TILE)
+			{
+				const size_t lastCol = std :: min<size_t>(jj + LAYOUT_TILE, colAmnt);
+				for(size_t i = firstBand * LAYOUT_TILE; i < lastRow; ++i)
+				{
+					for(size_t j = jj; j < lastCol; ++j)
+					{
+						out[_cellIndex(layout, rowAmnt, colAmnt, i, j)] =
+							in[_cellIndex(from, rowAmnt, colAmnt, i, j)];
+					}
+				}
+			}
+		});
 	}
-	
-	
+
 	/**
-	 * @brief Getter for the array of Matrix
-	 * @return pointer to the array of the IntMatrix
+	 * @brief A cell of the transpose, the cell itself except for Complex numbers
+	 * @param the cell
+	 * @return the transposed cell
 	 */
-	inline std :: vector<T>& getArr() const 
+	static T _transCell(const T& cell)
 	{
-		return _matrix;
+		return cell;
 	}
-	
-    
-	Matrix<T>& operator=(Matrix<T> other) 
+
+	/**
+	 * @brief Writes the transpose of our cells, converted by a callable, into a row major buffer.
+	 * Copies square tiles at a time so both the rows we read and the columns we write stay in
+	 * cache. Column major cells already are the row major transpose and are copied in order.
+	 * @param buffer of cols() x rows() cells
+	 * @param callable converting a cell
+	 */
+	template <typename Convert>
+	void _transposeInto(T *out, Convert convert) const
 	{
-		// use our swap friend function to swap between the matrix values 
-		swap(*this, other);
-		return *this;
+		const T *in = _data();
+		const unsigned int rowAmnt = rows();
+		const unsigned int colAmnt = cols();
+		if(_layout == LAYOUT_COL_MAJOR)
+		{
+			for(size_t i = 0; i < (size_t)rowAmnt * colAmnt; ++i)
+			{
+				out[i] = convert(in[i]);
+			}
+			return;
+		}
+		const unsigned int tile = std :: max(1u, _tuning(KERNEL_TRANS).tile);
+		MatrixCancellation *token = MatrixCancellation :: current().get();
+		if(token != nullptr)
+		{
+			token->addWork((size_t)rowAmnt * colAmnt);
+		}
+		for(unsigned int ii = 0; ii < rowAmnt; ii += tile)
+		{
+			const unsigned int lastRow = std :: min(ii + tile, rowAmnt);
+			if(token != nullptr)
+			{
+				token->check();
+				token->addDone((size_t)(lastRow - ii) * colAmnt);
+			}
+			for(unsigned int jj = 0; jj < colAmnt; jj += tile)
+			{
+				const unsigned int lastCol = std :: min(jj + tile, colAmnt);
+				for(unsigned int i = ii; i < lastRow; ++i)
+				{
+					for(unsigned int j = jj; j < lastCol; ++j)
+					{
+						out[(size_t)j * rowAmnt + i] = convert(in[_index(i, j)]);
+					}
+				}
+			}
+		}
 	}
 
 	/**
-	 * @brief Static function which receives pointers to three vectors and adds
-	 * the rows together.
+	 * @brief Getter for the tuned parameters of a kernel for our element type
+	 * @param the kernel
+	 * @return its parameters
+	 */
+	static const MatrixKernelTuning& _tuning(MatrixKernel kernel)
+	{
+		return MatrixTuning :: instance().kernel<T>(kernel);
+	}
+
+	/**
+	 * @brief Calls body on ranges of rows covering [0, rowAmnt). In parallel mode, when the
+	 * operation has at least the tuned threshold of cell operations, the ranges are split between
+	 * the tuned number of threads of the shared pool, each range holding enough rows for about
+	 * CHUNK_CELLS cell operations, and operations of a single chunk are never split. When the pool
+	 * is pinned the rows are instead split into one
+	 * fixed block per worker, so a worker writes the same rows of every result of these
+	 * dimensions. Otherwise body is called once on all the rows.
+	 * @param the tuned parameters of the kernel
+	 * @param name of the operation, for profiling
+	 * @param number of cells of the operation, for profiling
+	 * @param number of rows
+	 * @param number of cell operations done for a single row
+	 * @param callable receiving the first and one past the last row of a range
+	 */
+	template <typename Body>
+	static void _forEachRow(const MatrixKernelTuning& tuning, const char *op, size_t cells,
+							unsigned int rowAmnt, size_t rowCost, Body body)
+	{
+		_forEachRow(tuning, op, cells, rowAmnt, rowCost, 1, body);
+	}
+
+	/**
+	 * @brief _forEachRow for a blocked kernel that works on rowBlock rows at a time. The ranges
+	 * run on the pool and between cancellation checks hold a whole number of row blocks, so a
+	 * kernel reuses every tile it loads for all the rows of a block.
+	 * @param number of rows the kernel works on at a time
+	 * @see _forEachRow
+	 */
+	template <typename Body>
+	static void _forEachRow(const MatrixKernelTuning& tuning, const char *op, size_t cells,
+							unsigned int rowAmnt, size_t rowCost, size_t rowBlock, Body body)
+	{
+		// under a cancellation token the rows are run in blocks of about a chunk of work, the
+		// token checked before every block and the work of every finished block counted
+		MatrixCancellation *token = MatrixCancellation :: current().get();
+		if(token == nullptr)
+		{
+			_runRows(tuning, op, cells, rowAmnt, rowCost, rowBlock, body);
+			return;
+		}
+		token->addWork((size_t)rowAmnt * rowCost);
+		const size_t grain = _rowGrain(rowCost, rowBlock);
+		_runRows(tuning, op, cells, rowAmnt, rowCost, rowBlock, [&body, token, grain,
+																 rowCost](size_t first, size_t last)
+		{
+			for(size_t block = first; block < last; block += grain)
+			{
+				const size_t end = std :: min(block + grain, last);
+				token->check();
+				body(block, end);
+				token->addDone((end - block) * rowCost);
+			}
+		});
+	}
+
+	/**
+	 * @brief Number of rows in a chunk of _forEachRow: about CHUNK_CELLS cell operations,
+	 * rounded up to whole row blocks
+	 * @param number of cell operations done for a single row
+	 * @param number of rows the kernel works on at a time
+	 * @return the rows in a chunk
+	 */
+	static size_t _rowGrain(size_t rowCost, size_t rowBlock)
+	{
+		rowBlock = std :: max<size_t>(rowBlock, 1);
+		const size_t chunkRows = std :: max<size_t>(1, CHUNK_CELLS / std :: max<size_t>(rowCost, 1));
+		return (chunkRows + rowBlock - 1) / rowBlock * rowBlock;
+	}
+
+	/**
+	 * @brief Splits the rows of _forEachRow between the threads. A pinned pool gets one long
+	 * range per worker, which holds whole blocks but for its ends, so that every result of these
+	 * dimensions is still written by the same workers.
+	 * @see _forEachRow
+	 */
+	template <typename Body>
+	static void _runRows(const MatrixKernelTuning& tuning, const char *op, size_t cells,
+						 unsigned int rowAmnt, size_t rowCost, size_t rowBlock, Body body)
+	{
+		MATRIX_PERF_CALL(op, cells);
+		// work that fits in one chunk is never worth waking a thread for
+		const size_t work = (size_t)rowAmnt * rowCost;
+		if(_parallel && work > CHUNK_CELLS && work >= tuning.threshold)
+		{
+			ThreadPool& pool = ThreadPool :: shared();
+			auto range = [&](size_t first, size_t last)
+			{
+				MATRIX_TRACE_SCOPE("rows", first, last, 0, 1);
+				MATRIX_PERF_CHUNK(op, cells);
+				body(first, last);
+			};
+			if(pool.placement() != PLACEMENT_NONE)
+			{
+				pool.parallelForStatic(0, rowAmnt, range, tuning.threads);
+			}
+			else
+			{
+				pool.parallelFor(0, rowAmnt, _rowGrain(rowCost, rowBlock), range, tuning.threads);
+			}
+		}
+		else
+		{
+			MATRIX_PERF_CHUNK(op, cells);
+			body(0, rowAmnt);
+		}
+	}
+
+	/**
+	 * @brief Calls body on ranges of cells covering all our cells, split like the rows of an
+	 * elementwise operation by _forEachRow. The loops of the bodies run over plain contiguous
+	 * cells so the compiler can vectorize them.
+	 * @param name of the operation, for profiling
+	 * @param callable receiving the first and one past the last cell of a range
+	 */
+	template <typename Body>
+	void _forEachCell(const char *op, Body body) const
+	{
+		const size_t colAmnt = cols();
+		_forEachRow(_tuning(KERNEL_ADD), op, (size_t)rows() * colAmnt, rows(), colAmnt,
+					[=](size_t first, size_t last)
+		{
+			body(first * colAmnt, last * colAmnt);
+		});
+	}
+
+	/**
+	 * @brief Combines leaf(i) for i in [first, last) with a pairwise tree whose shape depends only
+	 * on the range: ranges of up to PAIRWISE_BASE values are folded in order, longer ones are
+	 * split in halves and the values of the halves combined.
+	 * @param first index
+	 * @param one past the last index
+	 * @param callable returning the value of an index
+	 * @param associative callable combining two values
+	 * @return the combined value, A() for an empty range
+	 */
+	template <typename A, typename Leaf, typename Combine>
+	static A _pairwise(size_t first, size_t last, const Leaf& leaf, const Combine& combine)
+	{
+		if(last - first <= PAIRWISE_BASE)
+		{
+			A value = first < last ? leaf(first) : A();
+			for(size_t i = first + 1; i < last; ++i)
+			{
+				value = combine(value, leaf(i));
+			}
+			return value;
+		}
+		const size_t middle = first + (last - first) / 2;
+		return combine(_pairwise<A>(first, middle, leaf, combine),
+					   _pairwise<A>(middle, last, leaf, combine));
+	}
+
+	/**
+	 * @brief Combines leaf(i) for i in [0, count) with a pairwise tree of a fixed shape. The
+	 * blocks of CHUNK_CELLS values at its leaves are combined on the pool threads in parallel
+	 * mode, and the values of the blocks by one more pairwise tree, so the shape and the result
+	 * never depend on the mode or on the threads.
+	 * @param name of the operation, for profiling
+	 * @param number of values
+	 * @param callable returning the value of an index
+	 * @param associative callable combining two values
+	 * @return the combined value, A() for no values
+	 */
+	template <typename A, typename Leaf, typename Combine>
+	static A _pairwiseReduce(const char *op, size_t count, Leaf leaf, Combine combine)
+	{
+		const size_t blockAmnt = (count + CHUNK_CELLS - 1) / CHUNK_CELLS;
+		if(blockAmnt <= 1)
+		{
+			return _pairwise<A>(0, count, leaf, combine);
+		}
+		std :: vector<A> partials(blockAmnt);
+		A *partial = partials.data();
+		_forEachRow(_tuning(KERNEL_ADD), op, count, blockAmnt, CHUNK_CELLS,
+					[=](size_t first, size_t last)
+		{
+			for(size_t block = first; block < last; ++block)
+			{
+				partial[block] = _pairwise<A>(block * CHUNK_CELLS,
+											  std :: min(count, (block + 1) * CHUNK_CELLS), leaf,
+											  combine);
+			}
+		});
+		return _pairwise<A>(0, blockAmnt, [partial](size_t block) { return partial[block]; },
+							combine);
+	}
+
+	/**
+	 * @brief Sums every line of contiguous cells with a pairwise tree, the lines split between
+	 * the pool threads in parallel mode
+	 * @param name of the operation, for profiling
+	 * @param the cells, lineAmnt lines of length cells one after the other
+	 * @param number of lines
+	 * @param number of cells of a line
+	 * @return the sums of the lines
+	 */
+	static std :: vector<T> _lineSums(const char *op, const T *cells, size_t lineAmnt,
+									  size_t length)
+	{
+		std :: vector<T> sums(lineAmnt);
+		T *sum = sums.data();
+		_forEachRow(_tuning(KERNEL_ADD), op, lineAmnt * length, lineAmnt, length,
+					[=](size_t first, size_t last)
+		{
+			for(size_t line = first; line < last; ++line)
+			{
+				const T *cell = cells + line * length;
+				sum[line] = _pairwise<T>(0, length, [cell](size_t i) { return cell[i]; },
+										 [](const T& a, const T& b) { return T(a + b); });
+			}
+		});
+		return sums;
+	}
+
+	/**
+	 * @brief Returns a matrix of a callable applied to every cell
+	 * @param name of the operation, for profiling
+	 * @param callable receiving a cell and returning the new cell
+	 * @return a new Matrix we created
+	 */
+	template <typename F>
+	Matrix<T> _map(const char *op, F function) const
+	{
+		MATRIX_TRACE_SCOPE(op, rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		// every cell is written, so the cells are left for the threads writing them to touch first
+		Matrix<T> result(rows(), cols(), _Uninitialized());
+		result._layout = _layout;
+		T *out = result._mutableData();
+		const T *cells = _data();
+		_forEachCell(op, [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				out[i] = function(cells[i]);
+			}
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Returns a matrix of a callable applied to every pair of cells at the same position in
+	 * the current matrix and another matrix of the same dimensions
+	 * @param name of the operation, for profiling
+	 * @param Matrix holding the second cell of every pair
+	 * @param callable receiving our cell and the other cell and returning the new cell
+	 * @return a new Matrix we created
+	 */
+	template <typename F>
+	Matrix<T> _zip(const char *op, const Matrix<T> &right, F function) const
+	{
+		// pairs of cells are at the same index only when both matrices have the same layout
+		if(right._layout != _layout)
+		{
+			return _zip(op, right.toLayout(_layout), function);
+		}
+		Matrix<T> result(rows(), cols(), _Uninitialized());
+		result._layout = _layout;
+		T *out = result._mutableData();
+		const T *cells = _data();
+		const T *other = right._data();
+		_forEachCell(op, [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				out[i] = function(cells[i], other[i]);
+			}
+		});
+		return result;
+	}
+	
+	/**
+	 * @brief blockMulti for a first matrix of any row or column major layout, its cell (i, k)
+	 * being first[i * rowStride + k * depthStride]
+	 * @see blockMulti
+	 */
+	static void _blockMulti(T *change, const T *first, const T *sec, size_t firstRow,
+							size_t lastRow, unsigned int depth, unsigned int secCols,
+							unsigned int tile, size_t rowStride, size_t depthStride)
+	{
+		tile = std :: max(1u, tile);
+		for(unsigned int kk = 0; kk < depth; kk += tile)
+		{
+			const unsigned int lastK = std :: min(kk + tile, depth);
+			for(unsigned int jj = 0; jj < secCols; jj += tile)
+			{
+				const unsigned int lastJ = std :: min(jj + tile, secCols);
+				for(size_t i = firstRow; i < lastRow; ++i)
+				{
+					T *changeRow = change + i * secCols;
+					for(unsigned int k = kk; k < lastK; ++k)
+					{
+						const T value = first[i * rowStride + k * depthStride];
+						const T *secRow = sec + (size_t)k * secCols;
+						for(unsigned int j = jj; j < lastJ; ++j)
+						{
+							changeRow[j] += value * secRow[j];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Multiplies a row major matrix by a column major one. Every cell of the product is a
+	 * dot product of a row and a column that are both contiguous.
+	 * @param Matrix we multiply by, column major
+	 * @return a new row major Matrix we created
+	 */
+	Matrix<T> _multiplyDot(const Matrix<T> &other) const
+	{
+		Matrix<T> product(rows(), other.cols(), _Uninitialized());
+		T *result = product._mutableData();
+		const T *left = _data();
+		const T *right = other._data();
+		const unsigned int depth = cols();
+		const unsigned int colAmnt = other.cols();
+		_forEachRow(_tuning(KERNEL_MULTIPLY), "multiply", (size_t)rows() * colAmnt, rows(),
+					(size_t)depth * colAmnt, [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				for(unsigned int j = 0; j < colAmnt; ++j)
+				{
+					result[i * colAmnt + j] = dotProduct(left + i * depth,
+														 right + (size_t)j * depth, depth, 1);
+				}
+			}
+		});
+		return product;
+	}
+
+	/**
+	 * @brief Multiplies two tiled matrices tile by tile. Every tile is contiguous, so the three
+	 * tiles multiplied at a time stay in cache without being repacked. Bands of tile rows of the
+	 * product are split between the pool threads in parallel mode.
+	 * @param Matrix we multiply by, tiled
+	 * @return a new tiled Matrix we created
+	 */
+	Matrix<T> _multiplyTiled(const Matrix<T> &other) const
+	{
+		Matrix<T> product(rows(), other.cols(), _Uninitialized());
+		product._layout = LAYOUT_TILED;
+		T *result = product._mutableData();
+		const T *left = _data();
+		const T *right = other._data();
+		const size_t rowAmnt = rows();
+		const size_t depth = cols();
+		const size_t colAmnt = other.cols();
+		_forEachRow(_tuning(KERNEL_MULTIPLY), "multiply", rowAmnt * colAmnt,
+					(rowAmnt + LAYOUT_TILE - 1) / LAYOUT_TILE, LAYOUT_TILE * depth * colAmnt,
+					[=](size_t firstBand, size_t lastBand)
+		{
+			for(size_t band = firstBand * LAYOUT_TILE; band < lastBand * LAYOUT_TILE &&
+				band < rowAmnt; band += LAYOUT_TILE)
+			{
+				// a band of the product is contiguous, zero it and add the products of tiles
+				const size_t height = std :: min<size_t>(LAYOUT_TILE, rowAmnt - band);
+				std :: fill(result + band * colAmnt, result + (band + height) * colAmnt, T());
+				for(size_t kk = 0; kk < depth; kk += LAYOUT_TILE)
+				{
+					const size_t inner = std :: min<size_t>(LAYOUT_TILE, depth - kk);
+					const T *leftTile = left + band * depth + kk * height;
+					for(size_t jj = 0; jj < colAmnt; jj += LAYOUT_TILE)
+					{
+						const size_t width = std :: min<size_t>(LAYOUT_TILE, colAmnt - jj);
+						const T *rightTile = right + kk * colAmnt + jj * inner;
+						T *resultTile = result + band * colAmnt + jj * height;
+						for(size_t i = 0; i < height; ++i)
+						{
+							for(size_t k = 0; k < inner; ++k)
+							{
+								const T value = leftTile[i * inner + k];
+								for(size_t j = 0; j < width; ++j)
+								{
+									resultTile[i * width + j] += value * rightTile[k * width + j];
+								}
+							}
+						}
+					}
+				}
+			}
+		});
+		return product;
+	}
+
+	/**
+	 * @brief Multiplies by another matrix summing the products in an accumulator type, each row
+	 * of the product a band of at most a tile of rows at a time. The sums of a band are kept in
+	 * the accumulator type over the whole inner dimension and converted to the cell type of the
+	 * product once, so only the cells read are narrow.
+	 * @param name of the operation, for profiling
+	 * @param Matrix we multiply by
+	 * @return a new row major Matrix we created
+	 */
+	template <typename A, typename Out>
+	Matrix<Out> _multiplyWide(const char *op, const Matrix<T> &other) const
+	{
+		if(cols() != other.rows())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).template _multiplyWide<A, Out>(op, other);
+		}
+		if(other._layout != LAYOUT_ROW_MAJOR)
+		{
+			return _multiplyWide<A, Out>(op, other.toLayout(LAYOUT_ROW_MAJOR));
+		}
+		MATRIX_TRACE_SCOPE(op, rows(), other.cols(),
+						   ((size_t)rows() * cols() + (size_t)other.rows() * other.cols()) *
+						   sizeof(T) + (size_t)rows() * other.cols() * sizeof(Out), _threadsUsed());
+		Matrix<Out> product(rows(), other.cols(), typename Matrix<Out> :: _Uninitialized());
+		Out *result = product._mutableData();
+		const T *left = _data();
+		const T *right = other._data();
+		const size_t depth = cols();
+		const size_t colAmnt = other.cols();
+		const MatrixKernelTuning& tuning = _tuning(KERNEL_MULTIPLY);
+		const size_t tile = std :: max(1u, tuning.tile);
+		_forEachRow(tuning, op, (size_t)rows() * colAmnt, rows(), depth * colAmnt, tile,
+					[=](size_t first, size_t last)
+		{
+			std :: vector<A, MatrixAllocator<A>> sums(std :: min(tile, last - first) * colAmnt);
+			for(size_t band = first; band < last; band += tile)
+			{
+				const size_t height = std :: min(tile, last - band);
+				std :: fill(sums.begin(), sums.begin() + height * colAmnt, A());
+				for(size_t kk = 0; kk < depth; kk += tile)
+				{
+					const size_t lastK = std :: min(kk + tile, depth);
+					for(size_t jj = 0; jj < colAmnt; jj += tile)
+					{
+						const size_t lastJ = std :: min(jj + tile, colAmnt);
+						for(size_t i = 0; i < height; ++i)
+						{
+							A *sumRow = sums.data() + i * colAmnt;
+							for(size_t k = kk; k < lastK; ++k)
+							{
+								const A value = A(left[(band + i) * depth + k]);
+								const T *secRow = right + k * colAmnt;
+								for(size_t j = jj; j < lastJ; ++j)
+								{
+									sumRow[j] += value * A(secRow[j]);
+								}
+							}
+						}
+					}
+				}
+				for(size_t i = 0; i < height * colAmnt; ++i)
+				{
+					result[band * colAmnt + i] = Out(sums[i]);
+				}
+			}
+		});
+		return product;
+	}
+
+	/**
+	 * @brief Multiplies the current matrix, or its transpose when adjoint, by a row major matrix
+	 * with the blocked kernel, reading our cells in any row or column major layout through
+	 * strides. Complex matrices specialize it with the 3M method.
+	 * @param Matrix we multiply by, row major
+	 * @param whether to multiply our transpose
+	 * @return a new row major Matrix we created
+	 */
+	Matrix<T> _multiplyBlocked(const Matrix<T> &other, bool adjoint) const
+	{
+		const unsigned int rowAmnt = adjoint ? cols() : rows();
+		MATRIX_TRACE_SCOPE(adjoint ? "conjTransMultiply" : "multiply", rowAmnt, other.cols(),
+						   ((size_t)rows() * cols() + (size_t)other.rows() * other.cols() +
+							(size_t)rowAmnt * other.cols()) * sizeof(T), _threadsUsed());
+		// initialize a matrix of the proper size, the thread computing a row zeroes it first
+		Matrix<T> tmpMatrix(rowAmnt, other.cols(), _Uninitialized());
+		// add the products of rows and columns into the zeroed cells tile by tile, splitting the
+		// rows between the pool threads if we are parallel
+		const MatrixKernelTuning& tuning = _tuning(KERNEL_MULTIPLY);
+		T *result = tmpMatrix._mutableData();
+		const T *left = _data();
+		const T *right = other._data();
+		const unsigned int depth = other.rows();
+		const unsigned int colAmnt = other.cols();
+		size_t rowStride = _layout == LAYOUT_ROW_MAJOR ? cols() : 1;
+		size_t depthStride = _layout == LAYOUT_ROW_MAJOR ? 1 : rows();
+		if(adjoint)
+		{
+			std :: swap(rowStride, depthStride);
+		}
+		_forEachRow(tuning, adjoint ? "conjTransMultiply" : "multiply",
+					(size_t)tmpMatrix.rows() * tmpMatrix.cols(), tmpMatrix.rows(),
+					(size_t)depth * colAmnt, tuning.tile, [=](size_t first, size_t last)
+		{
+			std :: fill(result + first * colAmnt, result + last * colAmnt, T());
+			_blockMulti(result, left, right, first, last, depth, colAmnt, tuning.tile, rowStride,
+						depthStride);
+		});
+		return tmpMatrix;
+	}
+
+	/**
+	 * @brief Checks a predicate on every pair of blocks of cells at the same positions in the
+	 * current matrix and another of the same dimensions and layout. Blocks of COMPARE_BLOCK cells
+	 * are split between the pool threads in parallel mode, and once a block fails every thread
+	 * skips the blocks it has left.
+	 * @param name of the operation, for profiling
+	 * @param Matrix holding the second block of every pair
+	 * @param callable receiving our block, the other block and their length
+	 * @return true if the predicate holds on every pair, false otherwise
+	 */
+	template <typename Pred>
+	bool _allBlocks(const char *op, const Matrix<T> &right, Pred pred) const
+	{
+		std :: atomic<bool> failed(false);
+		std :: atomic<bool> *stop = &failed;
+		const T *left = _data();
+		const T *other = right._data();
+		_forEachCell(op, [=](size_t first, size_t last)
+		{
+			for(size_t block = first; block < last && !stop->load(std :: memory_order_relaxed);
+				block += COMPARE_BLOCK)
+			{
+				const size_t length = std :: min<size_t>(COMPARE_BLOCK, last - block);
+				if(!pred(left + block, other + block, length))
+				{
+					*stop = true;
+				}
+			}
+		});
+		return !failed;
+	}
+
+	/**
+	 * @brief Checks whether two blocks of integers are equal, comparing their bytes
+	 * @param first block
+	 * @param second block
+	 * @param number of cells
+	 * @return true if equal, false otherwise
+	 */
+	static bool _blockEqual(const T *left, const T *other, size_t length, std :: true_type)
+	{
+		return std :: memcmp(left, other, length * sizeof(T)) == 0;
+	}
+
+	/**
+	 * @brief Checks whether two blocks of cells are equal with the == of the cells, without
+	 * branching inside the block so the loop can be vectorized
+	 * @see _blockEqual
+	 */
+	static bool _blockEqual(const T *left, const T *other, size_t length, std :: false_type)
+	{
+		bool equal = true;
+		for(size_t i = 0; i < length; ++i)
+		{
+			equal &= left[i] == other[i];
+		}
+		return equal;
+	}
+
+	/**
+	 * @brief Distance between two cells for allClose, |a - b| unless specialized
+	 * @param first cell
+	 * @param second cell
+	 * @return the distance
+	 */
+	static double _distance(const T& first, const T& second)
+	{
+		return std :: fabs((double)first - (double)second);
+	}
+
+	/**
+	 * @brief Magnitude of a cell for allClose, |a| unless specialized
+	 * @param the cell
+	 * @return the magnitude
+	 */
+	static double _magnitude(const T& cell)
+	{
+		return std :: fabs((double)cell);
+	}
+
+	/**
+	 * @brief Hash of a cell, of its bytes unless specialized. A floating zero is hashed as +0,
+	 * which it equals.
+	 * @param the cell
+	 * @return the hash
+	 */
+	static uint64_t _cellHash(const T& cell)
+	{
+		const T value = std :: is_floating_point<T> :: value && cell == T() ? T() : cell;
+		return _bytesHash(&value, sizeof(T));
+	}
+
+	/**
+	 * @brief Hash of some bytes, eight at a time
+	 * @param the bytes
+	 * @param number of bytes
+	 * @return the hash
+	 */
+	static uint64_t _bytesHash(const void *bytes, size_t length)
+	{
+		uint64_t hash = length;
+		for(size_t offset = 0; offset < length; offset += sizeof(uint64_t))
+		{
+			uint64_t word = 0;
+			std :: memcpy(&word, static_cast<const char *>(bytes) + offset,
+						  std :: min(sizeof(uint64_t), length - offset));
+			hash = _mixHash(hash ^ word);
+		}
+		return hash;
+	}
+
+	/**
+	 * @brief Mixes the bits of a number so that close numbers get unrelated hashes
+	 * @param the number
+	 * @return the mixed number
+	 */
+	static uint64_t _mixHash(uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ULL;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBULL;
+		return value ^ (value >> 31);
+	}
+
+	/**
+	 * @brief Parses a matrix text, counting the rows of its pieces and then parsing them on the
+	 * pool threads in parallel mode
+	 * @param the text, ending with a '\0'
+	 * @param name of the text for errors
+	 * @return a new Matrix we created
+	 */
+	static Matrix<T> _parseText(const std :: vector<char>& text, const std :: string& source)
+	{
+		const char *begin = text.data();
+		const std :: vector<const char *> pieces = splitMatrixText(begin, begin + text.size() - 1);
+		const size_t pieceAmnt = pieces.size() - 1;
+		// every piece starts at the row after the rows of the pieces before it
+		std :: vector<size_t> firstRows(pieceAmnt + 1, 0);
+		size_t *firstRow = firstRows.data();
+		_forEachRow(_tuning(KERNEL_ADD), "loadText", text.size(), pieceAmnt, TEXT_PIECE,
+					[=, &pieces](size_t first, size_t last)
+		{
+			for(size_t piece = first; piece < last; ++piece)
+			{
+				firstRow[piece + 1] = countTextRows(pieces[piece], pieces[piece + 1]);
+			}
+		});
+		for(size_t piece = 0; piece < pieceAmnt; ++piece)
+		{
+			firstRows[piece + 1] += firstRows[piece];
+		}
+		const char *line = begin;
+		while(*line != '\0' && skipBlankTextLine(line))
+		{
+		}
+		const size_t rowAmnt = firstRows.back();
+		const size_t colAmnt = countTextCells(line);
+		if(rowAmnt == 0 || colAmnt == 0 || rowAmnt > std :: numeric_limits<unsigned int> :: max() ||
+		   colAmnt > std :: numeric_limits<unsigned int> :: max())
+		{
+			throw std :: runtime_error(BAD_TEXT_MESSAGE + source);
+		}
+		MATRIX_TRACE_SCOPE("loadText", rowAmnt, colAmnt, text.size() + rowAmnt * colAmnt * sizeof(T),
+						   _threadsUsed());
+		Matrix<T> result(rowAmnt, colAmnt, _Uninitialized());
+		T *cells = result._mutableData();
+		_forEachRow(_tuning(KERNEL_ADD), "loadText", rowAmnt * colAmnt, pieceAmnt, TEXT_PIECE,
+					[=, &pieces, &source](size_t first, size_t last)
+		{
+			for(size_t piece = first; piece < last; ++piece)
+			{
+				const char *cursor = pieces[piece];
+				for(size_t row = firstRow[piece]; cursor < pieces[piece + 1]; )
+				{
+					if(skipBlankTextLine(cursor))
+					{
+						continue;
+					}
+					if(!parseTextRow(cursor, cells + row++ * colAmnt, colAmnt))
+					{
+						throw std :: runtime_error(BAD_TEXT_MESSAGE + source);
+					}
+				}
+			}
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Runs a binary operation on the shared pool on copies of the current matrix and of
+	 * another one. The copies are shared by the task instead of being copied along with it.
+	 * @param the right operand, moved into the task
+	 * @param callable receiving the left and the right operand
+	 * @return a future of the value of the operation
+	 */
+	template <typename Op>
+	MatrixFuture<Matrix<T>> _runAsync(Matrix<T> right, Op op) const
+	{
+		std :: shared_ptr<const Matrix<T>> left = std :: make_shared<const Matrix<T>>(*this);
+		std :: shared_ptr<const Matrix<T>> other =
+			std :: make_shared<const Matrix<T>>(std :: move(right));
+		return MatrixFuture<Matrix<T>> :: run([left, other, op]() { return op(*left, *other); });
+	}
+
+public:
+	
+    /**
+     * @brief A default constructor which receives no values.
+     */
+	Matrix<T>(): _rowNum(DEF_SIZE), _colNum(DEF_SIZE), _layout(LAYOUT_ROW_MAJOR)
+	{
+		// intiialize a matrix with default values, a single cell is always kept inline
+		_inline[0] = DEF_VALUE;
+	}
+    
+    /**
+     * @brief A copy constructor which receives an IntMatrix object and deep copies it.
+     * @param An Matrix object to be copied.
+     */
+	Matrix<T>(const Matrix<T> &copyMatrix) : _rowNum(copyMatrix.rows()),
+											 _colNum(copyMatrix.cols()),
+											 _mapping(copyMatrix._mapping),
+											 _shared(copyMatrix._shared),
+											 _layout(copyMatrix._layout)
+	{
+		// a mapped matrix is read only, so its copies can share the mapping, and shared cells are
+		// only copied by the first copy writing to them
+		if(_isInline())
+		{
+			std :: copy(copyMatrix._inline, copyMatrix._inline + (size_t)rows() * cols(), _inline);
+		}
+		else if(!_mapping && !_shared)
+		{
+			try
+			{
+				_matrix = copyMatrix._matrix;
+				MATRIX_TRACE_ALLOC();
+				_adopt();
+			}
+			catch (std :: bad_alloc &e)
+			{
+				BAD_ALLOC_PRINT;
+				throw;
+			}
+		}
+	}
+	
+
+	/**
+	 * @brief A move constructor which takes over the cells of a temporary Matrix.
+	 * @param An Matrix object to be moved.
+	 */
+	Matrix<T>(Matrix<T> && copyMatrix) : _rowNum(copyMatrix.rows()),
+										_colNum(copyMatrix.cols()),
+										_matrix(std :: move(copyMatrix._matrix)),
+										_mapping(std :: move(copyMatrix._mapping)),
+										_shared(std :: move(copyMatrix._shared)),
+										_layout(copyMatrix._layout)
+	{
+		if(_isInline())
+		{
+			std :: copy(copyMatrix._inline, copyMatrix._inline + (size_t)rows() * cols(), _inline);
+		}
+	}
+
+	/**
+	 * @brief A constructor which maps a matrix file read only and uses its cells in place. No cell
+	 * is copied, the file is only read from when a cell is touched.
+	 * @param the mapped file
+	 */
+	explicit Matrix<T>(const std :: shared_ptr<const MappedMatrixFile>& file) :
+		_mapping(file), _layout(LAYOUT_ROW_MAJOR)
+	{
+		if(!_mapping->template holds<T>())
+		{
+			throw std :: runtime_error(DTYPE_FILE_MESSAGE + _mapping->path());
+		}
+		const MatrixFileHeader& header = _mapping->header();
+		if(header.rows > std :: numeric_limits<unsigned int> :: max() ||
+		   header.cols > std :: numeric_limits<unsigned int> :: max() ||
+		   ((!header.rows)^(!header.cols)))
+		{
+			throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+		}
+		_rowNum = header.rows;
+		_colNum = header.cols;
+	}
+
+	/**
+	 * @brief A constructor which maps the matrix file at the given path.
+	 * @param path of the matrix file
+	 * @see Matrix<T>(const std :: shared_ptr<const MappedMatrixFile>&)
+	 */
+	explicit Matrix<T>(const std :: string& path) :
+		Matrix<T>(std :: make_shared<const MappedMatrixFile>(path))
+	{
+	}
+	
+    /**
+     * @brief A constructor which receives the dimensions of the matrix and an array and creates a
+     * new Matrix
+     * @param row dimension
+     * @param column dimension
+     * @param array of ints
+     */
+	Matrix<T> (unsigned int row, unsigned int col, const std :: vector<T>& cells): _rowNum(row),
+																				_colNum(col),
+																				_layout(LAYOUT_ROW_MAJOR)
+	{
+		// if the size does not match the dimension throw an exception, otherwise set vector
+		if(row * col != cells.size() || ((!rows())^(!cols())))
+		{
+			   throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+		}
+		if(_isInline())
+		{
+			std :: copy(cells.begin(), cells.end(), _inline);
+			return;
+		}
+		try 
+		{
+			// copy each object from the vector into our Matrix's vector
+			for(unsigned int i = 0; i < cells.size(); ++i)
+			{
+				_matrix.push_back(cells[i]);
+			}
+			MATRIX_TRACE_ALLOC();
+			_adopt();
+		}
+		catch (std :: bad_alloc &e)
+		{
+			// The forum reply was inconclusive as to whether to print a message or just throw an exception so I did both
+			BAD_ALLOC_PRINT;
+			throw;
+		}
+
+	}
+	
+    /**
+     * @brief A constructor which receives the dimensions and creates a new empty Matrix
+     * @param row dimension
+     * @param column dimension
+     */
+	Matrix<T>(unsigned int rowAmnt, unsigned int colAmnt): _rowNum(rowAmnt), _colNum(colAmnt),
+														   _layout(LAYOUT_ROW_MAJOR)
+	{
+		// if the size does not match the dimension throw an exception, otherwise set vector
+		if((!rows())^(!cols()))
+		{
+			   throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+		}
+		// set a new vector of proper size full of 0s
+		if(_isInline())
+		{
+			std :: fill(_inline, _inline + (size_t)rowAmnt * colAmnt, T(DEF_VALUE));
+			return;
+		}
+		try
+		{
+			_matrix.assign((size_t)rowAmnt * colAmnt, T(DEF_VALUE));
+			MATRIX_TRACE_ALLOC();
+			_adopt();
+		}
+		catch (std :: bad_alloc &e)
+		{
+			BAD_ALLOC_PRINT;
+			throw;
+		}
+	}
+	
+	
+	/**
+	 * @brief Pins the workers of the shared pool to cores, or unpins them. Pinned, the parallel
+	 * kernels split their rows into one fixed block per worker.
+	 * @param compact to fill a NUMA node before the next, spread to alternate the nodes, none to
+	 * unpin
+	 */
+	static void setPlacement(ThreadPlacement placement)
+	{
+		ThreadPool :: shared().pin(placement);
+	}
+
+	/**
+	 * @brief Turns copy on write on or off for matrices of our type. While on, the cells of new
+	 * matrices are put in reference counted buffers, copies share the buffer instead of copying
+	 * the cells, and a matrix copies the cells it shares only on its first write to them. A matrix
+	 * that hands out a reference to a cell with operator() stops sharing, its copies copy the
+	 * cells. Turning it off only stops new matrices from sharing.
+	 * @param true to share, false to copy
+	 */
+	static void setShared(bool val)
+	{
+		_sharing = val;
+	}
+
+	static void setParallel(bool val)
+	{
+		// if the value should change
+		if(val != _parallel)
+		{
+			// then change it and print appropriate message
+			_parallel = val;
+			if(val == true)
+			{
+				PAR_MACRO(PARALLEL);
+			}
+			else
+			{
+				PAR_MACRO(NON_PARALLEL);
+			}
+		}
+	}
+	
+	/**
+	 * @brief Getter for the row dimension of the IntMatrix.
+	 * @return Int row dimension
+	 */
+	inline unsigned int rows() const
+	{
+		return _rowNum;
+	}
+	
+	/**
+	 * @brief Getter for the column dimension of the IntMatrix.
+	 * @return Column dimension
+	 */
+	inline unsigned int cols() const
+	{
+		return _colNum;
+	}
+	
+	
+	/**
+	 * @brief Getter for a copy of the cells of Matrix in row major order, whatever its layout
+	 * and wherever its cells are stored
+	 * @return vector of rows() * cols() cells
+	 */
+	std :: vector<T> getArr() const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).getArr();
+		}
+		const T *cells = _data();
+		return std :: vector<T>(cells, cells + (size_t)rows() * cols());
+	}
+
+	/**
+	 * @brief Checks whether the cells of the matrix are shared with a copy of it
+	 * @return true if shared, false otherwise
+	 */
+	inline bool isShared() const
+	{
+		return _shared && _shared.use_count() != 1;
+	}
+
+	/**
+	 * @brief Getter for the order the cells are stored in
+	 * @return the layout
+	 */
+	inline MatrixLayout layout() const
+	{
+		return _layout;
+	}
+
+	/**
+	 * @brief Returns a copy of the matrix storing its cells in another layout. Elementwise
+	 * operations give results in the layout of their left operand, and multiplication picks a
+	 * kernel by the layouts of both operands: tiled times tiled multiplies tile by tile into a
+	 * tiled result, row major times column major takes dot products of contiguous rows and
+	 * columns, and a column or row major left times a row major right runs the blocked kernel.
+	 * @param the layout
+	 * @return a new Matrix we created
+	 */
+	Matrix<T> toLayout(MatrixLayout layout) const
+	{
+		if(layout == _layout)
+		{
+			return *this;
+		}
+		MATRIX_TRACE_SCOPE("toLayout", rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		Matrix<T> result(rows(), cols(), _Uninitialized());
+		_convertInto(result._mutableData(), layout);
+		result._layout = layout;
+		return result;
+	}
+
+	/**
+	 * @brief Transposes the matrix in place. A row or column major matrix only swaps its
+	 * dimensions and reads its cells in the other layout, no cell is moved. The cells of a Complex
+	 * matrix are still conjugated, and a tiled matrix is copied.
+	 * @return the current matrix
+	 */
+	Matrix<T>& transInPlace()
+	{
+		if(_layout == LAYOUT_TILED)
+		{
+			*this = trans();
+			return *this;
+		}
+		std :: swap(_rowNum, _colNum);
+		_layout = _layout == LAYOUT_ROW_MAJOR ? LAYOUT_COL_MAJOR : LAYOUT_ROW_MAJOR;
+		if(std :: is_same<T, Complex> :: value)
+		{
+			mapInPlace(&_transCell);
+		}
+		return *this;
+	}
+
+	/**
+	 * @brief Checks whether the cells of the matrix are mapped from a file
+	 * @return true if mapped, false otherwise
+	 */
+	inline bool isMapped() const
+	{
+		return static_cast<bool>(_mapping);
+	}
+
+	/**
+	 * @brief Writes the matrix to a binary matrix file that can later be mapped back. Files are
+	 * always row major. A mapped matrix cannot be written over the file it is mapped from.
+	 * @param path of the file to write
+	 */
+	void save(const std :: string& path) const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			toLayout(LAYOUT_ROW_MAJOR).save(path);
+			return;
+		}
+		MATRIX_TRACE_SCOPE("save", rows(), cols(), (size_t)rows() * cols() * sizeof(T), 1);
+		_checkNotMappedFrom(path);
+		std :: ofstream out(path.c_str(), std :: ios :: binary | std :: ios :: trunc);
+		if(!out)
+		{
+			throw std :: runtime_error(WRITE_FILE_MESSAGE + path);
+		}
+		// write the header, pad up to the aligned cell block, then write all cells at once
+		MatrixFileHeader header = MatrixFileHeader :: describe<T>(rows(), cols());
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		std :: vector<char> padding(header.dataOffset - sizeof(header), 0);
+		out.write(padding.data(), padding.size());
+		out.write(reinterpret_cast<const char *>(_data()), header.dataSize());
+		if(!out.flush())
+		{
+			throw std :: runtime_error(WRITE_FILE_MESSAGE + path);
+		}
+	}
+
+	/**
+	 * @brief Copies the matrix into a new POSIX shared memory object holding a matrix file, that
+	 * other processes can map read only with mapShared.
+	 * @param name of the object, "/name", that must not exist yet
+	 */
+	void saveShared(const std :: string& name) const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			toLayout(LAYOUT_ROW_MAJOR).saveShared(name);
+			return;
+		}
+		MATRIX_TRACE_SCOPE("saveShared", rows(), cols(), (size_t)rows() * cols() * sizeof(T), 1);
+		writeSharedMatrixFile(name, MatrixFileHeader :: describe<T>(rows(), cols()), _data());
+	}
+
+	/**
+	 * @brief Maps a shared memory object written by saveShared read only and uses its cells in
+	 * place, like a mapped matrix file.
+	 * @param name of the object
+	 * @return a new Matrix we created
+	 */
+	static Matrix<T> mapShared(const std :: string& name)
+	{
+		return Matrix<T>(MappedMatrixFile :: openShared(name));
+	}
+	
+
+	/**
+	 * @brief Reads a matrix text file, a row per line with the cells separated by tabs, spaces or
+	 * commas. Pieces of the file are parsed on the pool threads in parallel mode.
+	 * @param path of the file to read
+	 * @return a new Matrix we created
+	 */
+	static Matrix<T> loadText(const std :: string& path)
+	{
+		return _parseText(readMatrixText(path), path);
+	}
+
+	/**
+	 * @brief Writes the matrix as text, a row per line. Numbers are written with the digits that
+	 * read back to the same number. Pieces of rows are formatted into reused buffers on the pool
+	 * threads in parallel mode, and the buffers written in order. A mapped matrix cannot be
+	 * written over the file it is mapped from.
+	 * @param path of the file to write
+	 * @param character separating the cells, a tab by default
+	 */
+	void saveText(const std :: string& path, char delimiter = '\t') const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			toLayout(LAYOUT_ROW_MAJOR).saveText(path, delimiter);
+			return;
+		}
+		MATRIX_TRACE_SCOPE("saveText", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		_checkNotMappedFrom(path);
+		std :: ofstream out(path.c_str(), std :: ios :: binary | std :: ios :: trunc);
+		if(!out)
+		{
+			throw std :: runtime_error(WRITE_FILE_MESSAGE + path);
+		}
+		const T *cells = _data();
+		const size_t rowAmnt = rows();
+		const size_t colAmnt = cols();
+		const size_t rowsPerPiece = std :: max<size_t>(1, TEXT_PIECE_CELLS / colAmnt);
+		const size_t pieceAmnt = (rowAmnt + rowsPerPiece - 1) / rowsPerPiece;
+		// format as many pieces at a time as there are threads, then write them in order
+		std :: vector<std :: string> buffers(std :: min<size_t>(_threadsUsed(), pieceAmnt));
+		for(size_t firstPiece = 0; firstPiece < pieceAmnt; firstPiece += buffers.size())
+		{
+			const size_t batch = std :: min(buffers.size(), pieceAmnt - firstPiece);
+			_forEachRow(_tuning(KERNEL_ADD), "saveText", batch * rowsPerPiece * colAmnt, batch,
+						rowsPerPiece * colAmnt, [&](size_t first, size_t last)
+			{
+				for(size_t piece = first; piece < last; ++piece)
+				{
+					std :: string& buffer = buffers[piece];
+					buffer.clear();
+					const size_t firstRow = (firstPiece + piece) * rowsPerPiece;
+					const size_t lastRow = std :: min(firstRow + rowsPerPiece, rowAmnt);
+					for(size_t i = firstRow; i < lastRow; ++i)
+					{
+						for(size_t j = 0; j < colAmnt; ++j)
+						{
+							if(j > 0)
+							{
+								buffer += delimiter;
+							}
+							MatrixTextCodec<T> :: format(buffer, cells[i * colAmnt + j]);
+						}
+						buffer += '\n';
+					}
+				}
+			});
+			for(size_t piece = 0; piece < batch; ++piece)
+			{
+				out.write(buffers[piece].data(), buffers[piece].size());
+			}
+		}
+		if(!out.flush())
+		{
+			throw std :: runtime_error(WRITE_FILE_MESSAGE + path);
+		}
+	}
+    
+	Matrix<T>& operator=(Matrix<T> other) 
+	{
+		// use our swap friend function to swap between the matrix values 
+		swap(*this, other);
+		return *this;
+	}
+
+	/**
+	 * @brief Static function which receives pointers to three vectors and adds
+	 * the rows together.
 	 * @param vector of T's we wish to change
 	 * @param first vector of T's we are adding together
 	 * @param second vector of T's we are adding together
 	 * @param length of the row we are adding
 	 */
-	static void addRows(T *changedArray, const T *firstArray , const T *secondArray, int lengthRow)
+	static void addRows(T *changedArray, const T *firstArray , const T *secondArray, int lengthRow)
+	{
+		for(int j = 0; j < lengthRow; ++j)
+		{
+			changedArray[j] = firstArray[j] + secondArray[j];
+		}
+	}
+	
+	/**
+	 * @brief Returns a matrix of a callable applied to every cell. Runs like the built in
+	 * operators, in chunks of rows on the pool in parallel mode, so the callable may be called
+	 * from several threads at once.
+	 * @param callable receiving a cell and returning the new cell
+	 * @return a new Matrix we created
+	 */
+	template <typename F>
+	Matrix<T> map(F function) const
+	{
+		return _map("map", function);
+	}
+
+	/**
+	 * @brief Replaces every cell by a callable applied to it, in chunks of rows on the pool in
+	 * parallel mode.
+	 * @param callable receiving a cell and returning the new cell
+	 * @return the current matrix
+	 */
+	template <typename F>
+	Matrix<T>& mapInPlace(F function)
+	{
+		MATRIX_TRACE_SCOPE("mapInPlace", rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		T *cells = _mutableData();
+		_forEachCell("mapInPlace", [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				cells[i] = function(cells[i]);
+			}
+		});
+		return *this;
+	}
+
+	/**
+	 * @brief Returns a matrix of a callable applied to every pair of cells at the same position in
+	 * the current matrix and another matrix of the same dimensions, in chunks of rows on the pool
+	 * in parallel mode.
+	 * @param Matrix holding the second cell of every pair
+	 * @param callable receiving our cell and the other cell and returning the new cell
+	 * @return a new Matrix we created
+	 */
+	template <typename F>
+	Matrix<T> zip(const Matrix<T> &right, F function) const
+	{
+		if(rows() != right.rows() || cols() != right.cols())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		return _zip("zip", right, function);
+	}
+
+	/**
+	 * @brief Replaces every cell by a callable applied to it and the cell at the same position in
+	 * another matrix of the same dimensions, in chunks of rows on the pool in parallel mode.
+	 * @param Matrix holding the second cell of every pair
+	 * @param callable receiving our cell and the other cell and returning the new cell
+	 * @return the current matrix
+	 */
+	template <typename F>
+	Matrix<T>& zipInPlace(const Matrix<T> &right, F function)
+	{
+		if(rows() != right.rows() || cols() != right.cols())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		if(right._layout != _layout)
+		{
+			return zipInPlace(right.toLayout(_layout), function);
+		}
+		MATRIX_TRACE_SCOPE("zipInPlace", rows(), cols(), 3 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		T *cells = _mutableData();
+		const T *other = right._data();
+		_forEachCell("zipInPlace", [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				cells[i] = function(cells[i], other[i]);
+			}
+		});
+		return *this;
+	}
+
+	/**
+	 * @brief Combines all the cells into one value. The cells are folded in fixed chunks of
+	 * CHUNK_CELLS in the order of our layout, in parallel mode on the pool, and the results of the
+	 * chunks are then folded in order, so the result does not depend on the mode or on the
+	 * threads.
+	 * @param identity of the callable, the value every fold starts from
+	 * @param associative callable receiving the value so far and a cell and returning the new
+	 * value
+	 * @return the combined value, identity for a matrix without cells
+	 */
+	template <typename F>
+	T reduce(const T& identity, F function) const
+	{
+		MATRIX_TRACE_SCOPE("reduce", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		const size_t cellAmnt = (size_t)rows() * cols();
+		const size_t chunkAmnt = (cellAmnt + CHUNK_CELLS - 1) / CHUNK_CELLS;
+		if(chunkAmnt <= 1)
+		{
+			// a single chunk is folded right here, without a buffer for the results of chunks
+			T value = identity;
+			const T *cells = _data();
+			for(size_t i = 0; i < cellAmnt; ++i)
+			{
+				value = function(value, cells[i]);
+			}
+			return chunkAmnt ? function(identity, value) : identity;
+		}
+		std :: vector<T> partials(chunkAmnt, identity);
+		T *partial = partials.data();
+		const T *cells = _data();
+		_forEachRow(_tuning(KERNEL_ADD), "reduce", cellAmnt, chunkAmnt, CHUNK_CELLS,
+					[=](size_t first, size_t last)
+		{
+			for(size_t chunk = first; chunk < last; ++chunk)
+			{
+				T value = identity;
+				const size_t lastCell = std :: min(cellAmnt, (chunk + 1) * CHUNK_CELLS);
+				for(size_t i = chunk * CHUNK_CELLS; i < lastCell; ++i)
+				{
+					value = function(value, cells[i]);
+				}
+				partial[chunk] = value;
+			}
+		});
+		T total = identity;
+		for(size_t chunk = 0; chunk < chunkAmnt; ++chunk)
+		{
+			total = function(total, partial[chunk]);
+		}
+		return total;
+	}
+
+	/**
+	 * @brief Sums all the cells with a pairwise tree of a fixed shape over the cells in row major
+	 * order, its leaf blocks summed on the pool threads in parallel mode. The sum is the same bit
+	 * for bit whatever the mode, the threads or the layout, and its rounding error grows with the
+	 * log of the number of cells rather than with the number.
+	 * @return the sum, T() for a matrix without cells
+	 */
+	T sum() const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).sum();
+		}
+		MATRIX_TRACE_SCOPE("sum", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		const T *cells = _data();
+		return _pairwiseReduce<T>("sum", (size_t)rows() * cols(),
+								  [cells](size_t i) { return cells[i]; },
+								  [](const T& a, const T& b) { return T(a + b); });
+	}
+
+	/**
+	 * @brief Calculates the Frobenius norm, the square root of the sum of the squared magnitudes
+	 * of the cells, summed like sum() so it is reproducible the same way
+	 * @return the norm
+	 */
+	double frobeniusNorm() const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).frobeniusNorm();
+		}
+		MATRIX_TRACE_SCOPE("frobeniusNorm", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		const T *cells = _data();
+		return std :: sqrt(_pairwiseReduce<double>("frobeniusNorm", (size_t)rows() * cols(),
+												   [cells](size_t i)
+												   {
+													   const double magnitude = _magnitude(cells[i]);
+													   return magnitude * magnitude;
+												   },
+												   [](double a, double b) { return a + b; }));
+	}
+
+	/**
+	 * @brief Finds the largest magnitude of a cell, in parallel mode on the pool threads
+	 * @return the largest magnitude, NaN if a cell is NaN, 0 for a matrix without cells
+	 */
+	double maxAbs() const
+	{
+		MATRIX_TRACE_SCOPE("maxAbs", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		// the largest magnitude does not depend on the order, any layout will do
+		const T *cells = _data();
+		return _pairwiseReduce<double>("maxAbs", (size_t)rows() * cols(),
+									   [cells](size_t i) { return _magnitude(cells[i]); },
+									   [](double a, double b) { return b > a || b != b ? b : a; });
+	}
+
+	/**
+	 * @brief Sums every row, each with a pairwise tree like sum(), the rows split between the
+	 * pool threads in parallel mode
+	 * @return the sums of the rows from the first row on
+	 */
+	std :: vector<T> rowSums() const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).rowSums();
+		}
+		MATRIX_TRACE_SCOPE("rowSums", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _lineSums("rowSums", _data(), rows(), cols());
+	}
+
+	/**
+	 * @brief Sums every column, each with a pairwise tree like sum(), the columns split between
+	 * the pool threads in parallel mode
+	 * @return the sums of the columns from the first column on
+	 */
+	std :: vector<T> colSums() const
+	{
+		if(_layout != LAYOUT_COL_MAJOR)
+		{
+			return toLayout(LAYOUT_COL_MAJOR).colSums();
+		}
+		MATRIX_TRACE_SCOPE("colSums", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _lineSums("colSums", _data(), cols(), rows());
+	}
+
+    /**
+     * @brief Overrides + operator for Matrix to add a matrix to current matrix.
+     * @param Matrix we wish to add to the current matrix.
+     * @return a new Matrix we created
+     */
+    const Matrix<T> operator+(const Matrix<T> &right) const
+	{
+		if(rows() != right.rows() || cols() != right.cols())
+		{
+			throw BadDimensionException(ADD_WRONG_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("add", rows(), cols(), 3 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _zip("add", right, [](const T& left, const T& other) { return left + other; });
+	}
+    
+    /**
+     * @brief Overrides - operator for Matrix to subtract a matrix from the current matrix.
+     * @param Matrix we wish to subtract from the current matrix.
+     * @return a new Matrix we created
+     */
+    const Matrix<T> operator-(const Matrix<T> &right) const
+	{
+		if(rows() != right.rows() || cols() != right.cols())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("subtract", rows(), cols(), 3 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _zip("subtract", right, [](const T& left, const T& other) { return left - other; });
+	}
+
+	/**
+	 * @brief Overrides + operator to add a scalar to every cell of the current matrix.
+	 * @param the scalar
+	 * @return a new Matrix we created
+	 */
+	const Matrix<T> operator+(const T& scalar) const
+	{
+		return _map("addScalar", [scalar](const T& cell) { return cell + scalar; });
+	}
+
+	/**
+	 * @brief Overrides - operator to subtract a scalar from every cell of the current matrix.
+	 * @param the scalar
+	 * @return a new Matrix we created
+	 */
+	const Matrix<T> operator-(const T& scalar) const
+	{
+		return _map("subtractScalar", [scalar](const T& cell) { return cell - scalar; });
+	}
+
+	/**
+	 * @brief Overrides * operator to multiply every cell of the current matrix by a scalar.
+	 * @param the scalar
+	 * @return a new Matrix we created
+	 */
+	const Matrix<T> operator*(const T& scalar) const
+	{
+		return _map("multiplyScalar", [scalar](const T& cell) { return cell * scalar; });
+	}
+
+	/**
+	 * @brief Overrides += operator to add a matrix to the current matrix in place.
+	 * @param Matrix we wish to add to the current matrix.
+	 * @return the current matrix
+	 */
+	Matrix<T>& operator+=(const Matrix<T> &right)
+	{
+		return zipInPlace(right, [](const T& left, const T& other) { return left + other; });
+	}
+
+	/**
+	 * @brief Overrides -= operator to subtract a matrix from the current matrix in place.
+	 * @param Matrix we wish to subtract from the current matrix.
+	 * @return the current matrix
+	 */
+	Matrix<T>& operator-=(const Matrix<T> &right)
+	{
+		return zipInPlace(right, [](const T& left, const T& other) { return left - other; });
+	}
+
+	/**
+	 * @brief Overrides *= operator to multiply every cell of the current matrix by a scalar.
+	 * @param the scalar
+	 * @return the current matrix
+	 */
+	Matrix<T>& operator*=(const T& scalar)
+	{
+		return mapInPlace([scalar](const T& cell) { return cell * scalar; });
+	}
+	
+	
+	/**
+	 * @brief Calculates the dot product between a row and column of valid sizes
+	 * @param pointer to begining of the row
+	 * @param pointer to the begining of the column
+	 * @param length of the row
+	 * @param length of the column
+	 * @return the dot product
+	 */
+	static T dotProduct(const T *firstArray, const T *secondArray,
+						unsigned int lengthRow, unsigned int lengthCol)
+	{
+		// create a new T object
+		T sum = T();
+		for(unsigned int i = 0; i < lengthRow; ++i)
+		{
+			// sum each row into that T object using it's operators
+			sum += firstArray[i] * secondArray[i * lengthCol];
+		}
+		return sum;
+	}
+	
+	
+	/**
+	 * @brief Adds the product of some rows of the first matrix and the second matrix to the same
+	 * rows of a result matrix. Walks the inner dimension and the result columns in square tiles
+	 * and loops in i-k-j order, so the innermost loop runs along rows of the second matrix and of
+	 * the result, and every tile of the second matrix is reused for all the rows while in cache.
+	 * The multiplies hand it whole blocks of tile rows, also when they split the rows between
+	 * the pool threads.
+	 * Each cell still adds its products in order of k, so the result equals the dot products.
+	 * @param cells of the result, rows x secCols
+	 * @param cells of the first matrix, rows x depth
+	 * @param cells of the second matrix, depth x secCols
+	 * @param first row to compute
+	 * @param one past the last row to compute
+	 * @param column dimension of the first matrix
+	 * @param column dimension of the second matrix
+	 * @param side of the tiles
+	 */
+	static void blockMulti(T *change, const T *first, const T *sec, size_t firstRow,
+						   size_t lastRow, unsigned int depth, unsigned int secCols,
+						   unsigned int tile)
+	{
+		_blockMulti(change, first, sec, firstRow, lastRow, depth, secCols, tile, depth, 1);
+	}
+
+	/**
+	 * @brief changes the value of each row in a inputted matrix by multiplying the row 
+	 * and column of the other inputted matrices, all of them row major
+	 * @param Matrix we wish to change
+	 * @param first matrix we are multiplying
+	 * @param second matrix we are multiplying
+	 * @param the row number
+	 */
+	static void rowMulti(Matrix<T>& change, const Matrix<T>& first, const Matrix<T>& sec, 
+						 unsigned int rowNum)
+	{
+		// go over all the indexes in the row and call dot product to change them
+		for(unsigned int j = 0; j < change.cols(); ++j)
+		{
+			change._mutableData()[(rowNum * change.cols()) + j] = dotProduct(
+																		 first._data() +
+																		 rowNum * first.cols(),
+																		 sec._data() + j,
+																		 first.cols(),
+																		 sec.cols());
+		}
+	}
+	
+    /**
+     * @brief Overrides * operator for Matrix to multiply a matrix by current matrix.
+     * @param Matrix we wish to multiply by the current matrix.
+     * @return a new Matrix we created
+     */
+    const Matrix<T> operator*(const Matrix<T> &other) const
+	{
+		if(cols() != other.rows())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		// pick the kernel for the layouts, converting to row major the operands none fits. Complex
+		// products are always taken as three real ones by the blocked kernel
+		const bool complex = std :: is_same<T, Complex> :: value;
+		if(_layout == LAYOUT_TILED && other._layout == LAYOUT_TILED && !complex)
+		{
+			return _multiplyTiled(other);
+		}
+		if(_layout == LAYOUT_TILED)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR) * other;
+		}
+		if(_layout == LAYOUT_ROW_MAJOR && other._layout == LAYOUT_COL_MAJOR && !complex)
+		{
+			return _multiplyDot(other);
+		}
+		if(other._layout != LAYOUT_ROW_MAJOR)
+		{
+			return *this * other.toLayout(LAYOUT_ROW_MAJOR);
+		}
+		return _multiplyBlocked(other, false);
+	}
+
+	/**
+	 * @brief Multiplies the conjugate transpose of the current matrix by another matrix, without
+	 * building the transpose: the blocked kernel reads our columns as the rows of the left
+	 * operand. For matrices of real numbers it is the transpose times the other matrix.
+	 * @param Matrix we wish to multiply by, with as many rows as the current matrix
+	 * @return a new Matrix we created
+	 */
+	Matrix<T> conjTransMultiply(const Matrix<T> &other) const
+	{
+		if(rows() != other.rows())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		if(_layout == LAYOUT_TILED)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).conjTransMultiply(other);
+		}
+		if(other._layout != LAYOUT_ROW_MAJOR)
+		{
+			return conjTransMultiply(other.toLayout(LAYOUT_ROW_MAJOR));
+		}
+		return _multiplyBlocked(other, true);
+	}
+
+	/**
+	 * @brief Adds the outer product of two vectors to the current matrix in place, A += x y^T,
+	 * without building either vector as a matrix. Rows of a row major matrix, or columns of a
+	 * column major one, are updated as contiguous runs split between the pool threads in parallel
+	 * mode. A tiled matrix keeps its layout but is updated through a row major copy.
+	 * @param vector of rows() cells
+	 * @param vector of cols() cells
+	 * @return the current matrix
+	 */
+	Matrix<T>& rankOneUpdate(const std :: vector<T>& x, const std :: vector<T>& y)
+	{
+		if(x.size() != rows() || y.size() != cols())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		if(_layout == LAYOUT_TILED)
+		{
+			Matrix<T> updated = toLayout(LAYOUT_ROW_MAJOR);
+			updated.rankOneUpdate(x, y);
+			*this = updated.toLayout(LAYOUT_TILED);
+			return *this;
+		}
+		MATRIX_TRACE_SCOPE("rankOneUpdate", rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		// a column major matrix is the row major transpose, updated by y x^T
+		const bool rowMajor = _layout == LAYOUT_ROW_MAJOR;
+		const T *outer = rowMajor ? x.data() : y.data();
+		const T *inner = rowMajor ? y.data() : x.data();
+		const size_t runs = rowMajor ? rows() : cols();
+		const size_t length = rowMajor ? cols() : rows();
+		T *cells = _mutableData();
+		_forEachRow(_tuning(KERNEL_ADD), "rankOneUpdate", runs * length, runs, length,
+					[=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				const T scale = outer[i];
+				T *run = cells + i * length;
+				for(size_t j = 0; j < length; ++j)
+				{
+					run[j] += scale * inner[j];
+				}
+			}
+		});
+		return *this;
+	}
+
+	/**
+	 * @brief Adds the product of two matrices to the current matrix in place, A += X Y, a rank
+	 * k update for an inner dimension of k. The blocked kernel adds into our own cells, so
+	 * neither the product nor a sum is built. A column major matrix is updated through strides
+	 * like rankOneUpdate does, a tiled one keeps its layout but is updated through a row major
+	 * copy. X or Y may be the current matrix itself.
+	 * @param Matrix of rows() rows
+	 * @param Matrix of cols() columns and as many rows as X has columns
+	 * @return the current matrix
+	 */
+	Matrix<T>& rankUpdate(const Matrix<T>& x, const Matrix<T>& y)
+	{
+		if(x.rows() != rows() || y.cols() != cols() || x.cols() != y.rows())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		if(&x == this || &y == this)
+		{
+			// the kernel reads the operands while it writes our cells, so it reads ours from a copy
+			const Matrix<T> operand(*this);
+			return rankUpdate(&x == this ? operand : x, &y == this ? operand : y);
+		}
+		if(_layout == LAYOUT_TILED)
+		{
+			Matrix<T> updated = toLayout(LAYOUT_ROW_MAJOR);
+			updated.rankUpdate(x, y);
+			*this = updated.toLayout(LAYOUT_TILED);
+			return *this;
+		}
+		// a column major matrix is the row major transpose, updated by Y^T X^T, for which the
+		// kernel walks the rows of X^T, so X must be column major
+		const bool rowMajor = _layout == LAYOUT_ROW_MAJOR;
+		if(x._layout == LAYOUT_TILED || (!rowMajor && x._layout != LAYOUT_COL_MAJOR))
+		{
+			return rankUpdate(x.toLayout(rowMajor ? LAYOUT_ROW_MAJOR : LAYOUT_COL_MAJOR), y);
+		}
+		if(y._layout == LAYOUT_TILED || (rowMajor && y._layout != LAYOUT_ROW_MAJOR))
+		{
+			return rankUpdate(x, y.toLayout(LAYOUT_ROW_MAJOR));
+		}
+		MATRIX_TRACE_SCOPE("rankUpdate", rows(), cols(),
+						   ((size_t)x.rows() * x.cols() + (size_t)y.rows() * y.cols() +
+							2 * (size_t)rows() * cols()) * sizeof(T), _threadsUsed());
+		const MatrixKernelTuning& tuning = _tuning(KERNEL_MULTIPLY);
+		const Matrix<T>& leftOperand = rowMajor ? x : y;
+		const Matrix<T>& rightOperand = rowMajor ? y : x;
+		T *result = _mutableData();
+		const T *left = leftOperand._data();
+		const T *right = rightOperand._data();
+		const unsigned int depth = x.cols();
+		const unsigned int runs = rowMajor ? rows() : cols();
+		const unsigned int colAmnt = rowMajor ? cols() : rows();
+		// the kernel reads cell (i, k) of X, or cell (k, i) of Y for the transpose
+		const size_t rowStep = leftOperand._layout == LAYOUT_ROW_MAJOR ? leftOperand.cols() : 1;
+		const size_t colStep = leftOperand._layout == LAYOUT_ROW_MAJOR ? 1 : leftOperand.rows();
+		const size_t rowStride = rowMajor ? rowStep : colStep;
+		const size_t depthStride = rowMajor ? colStep : rowStep;
+		_forEachRow(tuning, "rankUpdate", (size_t)rows() * cols(), runs, (size_t)depth * colAmnt,
+					tuning.tile, [=](size_t first, size_t last)
+		{
+			_blockMulti(result, left, right, first, last, depth, colAmnt, tuning.tile, rowStride,
+						depthStride);
+		});
+		return *this;
+	}
+
+	/**
+	 * @brief Returns the outer product of two vectors, x y^T
+	 * @param vector of the rows
+	 * @param vector of the columns
+	 * @return a new Matrix we created
+	 */
+	static Matrix<T> outer(const std :: vector<T>& x, const std :: vector<T>& y)
+	{
+		if(x.empty() || y.empty() || x.size() > std :: numeric_limits<unsigned int> :: max() ||
+		   y.size() > std :: numeric_limits<unsigned int> :: max())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("outer", x.size(), y.size(), x.size() * y.size() * sizeof(T),
+						   _threadsUsed());
+		Matrix<T> product(x.size(), y.size(), _Uninitialized());
+		T *cells = product._mutableData();
+		const T *rowCells = x.data();
+		const T *colCells = y.data();
+		const size_t colAmnt = y.size();
+		_forEachRow(_tuning(KERNEL_ADD), "outer", x.size() * colAmnt, x.size(), colAmnt,
+					[=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				const T scale = rowCells[i];
+				for(size_t j = 0; j < colAmnt; ++j)
+				{
+					cells[i * colAmnt + j] = scale * colCells[j];
+				}
+			}
+		});
+		return product;
+	}
+
+	/**
+	 * @brief Returns the Kronecker product of the current matrix and another, the block matrix
+	 * whose block (i, j) is our cell (i, j) times the other matrix. Every row of the product is
+	 * a row of the other matrix scaled by each cell of one of our rows in turn, written as
+	 * contiguous runs; the rows are split between the pool threads in parallel mode.
+	 * @param the other matrix
+	 * @return a new Matrix we created
+	 */
+	Matrix<T> kron(const Matrix<T>& other) const
+	{
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).kron(other);
+		}
+		if(other._layout != LAYOUT_ROW_MAJOR)
+		{
+			return kron(other.toLayout(LAYOUT_ROW_MAJOR));
+		}
+		const size_t rowAmnt = (size_t)rows() * other.rows();
+		const size_t colAmnt = (size_t)cols() * other.cols();
+		if(rowAmnt > std :: numeric_limits<unsigned int> :: max() ||
+		   colAmnt > std :: numeric_limits<unsigned int> :: max())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("kron", rowAmnt, colAmnt, rowAmnt * colAmnt * sizeof(T),
+						   _threadsUsed());
+		Matrix<T> product(rowAmnt, colAmnt, _Uninitialized());
+		T *result = product._mutableData();
+		const T *left = _data();
+		const T *right = other._data();
+		const size_t leftCols = cols();
+		const size_t rightRows = other.rows();
+		const size_t rightCols = other.cols();
+		_forEachRow(_tuning(KERNEL_ADD), "kron", rowAmnt * colAmnt, rowAmnt, colAmnt,
+					[=](size_t first, size_t last)
+		{
+			for(size_t row = first; row < last; ++row)
+			{
+				const T *leftRow = left + row / rightRows * leftCols;
+				const T *rightRow = right + row % rightRows * rightCols;
+				T *out = result + row * colAmnt;
+				for(size_t j = 0; j < leftCols; ++j)
+				{
+					const T scale = leftRow[j];
+					for(size_t q = 0; q < rightCols; ++q)
+					{
+						out[j * rightCols + q] = scale * rightRow[q];
+					}
+				}
+			}
+		});
+		return product;
+	}
+	
+	/**
+	 * @brief Multiplies by another matrix with the products summed in an accumulator type, and
+	 * returns the sums themselves: a Matrix<int> times another gives the exact Matrix<int64_t>,
+	 * a Matrix<float> the Matrix<double> of sums that lost no precision. The operands are read in
+	 * their own narrow type.
+	 * @param Matrix we wish to multiply by the current matrix
+	 * @return a new Matrix of the sums we created
+	 */
+	template <typename A = typename MatrixAccumulator<T> :: type>
+	Matrix<A> multiplyAccumulate(const Matrix<T> &other) const
+	{
+		return _multiplyWide<A, A>("multiplyAccumulate", other);
+	}
+
+	/**
+	 * @brief Multiplies by another matrix with the products summed in MatrixAccumulator<T> and
+	 * every sum rounded to T once, the product of operator* with the error of a single rounding
+	 * @param Matrix we wish to multiply by the current matrix
+	 * @return a new Matrix we created
+	 */
+	Matrix<T> multiplyWide(const Matrix<T> &other) const
+	{
+		return _multiplyWide<typename MatrixAccumulator<T> :: type, T>("multiplyWide", other);
+	}
+
+	/**
+	 * @brief Multiplies two matrix files into a third without loading them into memory. The
+	 * product is computed in tiles that fit the memory budget, reading the next tiles and writing
+	 * finished ones in the background. Splits each tile on the shared pool when in parallel mode.
+	 * @param path of the left operand matrix file
+	 * @param path of the right operand matrix file
+	 * @param path of the product matrix file to create
+	 * @param number of bytes the tiles may use together
+	 */
+	static void multiplyFiles(const std :: string& leftPath, const std :: string& rightPath,
+							  const std :: string& resultPath, size_t memoryBudget)
+	{
+		MATRIX_TRACE_SCOPE("multiplyFiles", 0, 0, memoryBudget, _threadsUsed());
+		multiplyOutOfCore<T>(leftPath, rightPath, resultPath, memoryBudget, _parallel);
+	}
+
+	/**
+	 * @brief Adds a matrix to the current matrix on the shared pool. The operands are copied
+	 * when the operation is started, so they may change or go away while it runs.
+	 * @param Matrix we wish to add to the current matrix.
+	 * @return a future of the sum
+	 */
+	MatrixFuture<Matrix<T>> addAsync(Matrix<T> right) const
 	{
-		for(int j = 0; j < lengthRow; ++j)
+		return _runAsync(std :: move(right), [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			changedArray[j] = firstArray[j] + secondArray[j];
-		}
+			return a + b;
+		});
 	}
-	
-    /**
-     * @brief Overrides + operator for Matrix to add a matrix to current matrix.
-     * @param Matrix we wish to add to the current matrix.
-     * @return a new Matrix we created
-     */
-    const Matrix<T> operator+(const Matrix<T> &right) const
+
+	/**
+	 * @brief Subtracts a matrix from the current matrix on the shared pool. The operands are
+	 * copied when the operation is started, so they may change or go away while it runs.
+	 * @param Matrix we wish to subtract from the current matrix.
+	 * @return a future of the difference
+	 */
+	MatrixFuture<Matrix<T>> subtractAsync(Matrix<T> right) const
 	{
-		if(rows() != right.rows() || cols() != right.cols())
+		return _runAsync(std :: move(right), [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			throw BadDimensionException(ADD_WRONG_MESSAGE);
-		}
-		// initialize a new Matrix<T> and an empty vector of threads
-		Matrix<T> additionMatrix(rows(), cols());
-		std :: vector<std :: thread> threadVector;
-		// iterate over the matrix by row
-		for(unsigned int i = 0; i < rows() ; ++i)
+			return a - b;
+		});
+	}
+
+	/**
+	 * @brief Multiplies the current matrix by a matrix on the shared pool. The operands are
+	 * copied when the operation is started, so they may change or go away while it runs.
+	 * @param Matrix we wish to multiply by the current matrix.
+	 * @return a future of the product
+	 */
+	MatrixFuture<Matrix<T>> multiplyAsync(Matrix<T> other) const
+	{
+		return _runAsync(std :: move(other), [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			
-			// if our parallel is set to true then open a thread for each row calulation
-			if(_parallel)
-			{
-				// push the thread into a vector to join later
-				threadVector.push_back(std :: thread (addRows, &additionMatrix._matrix[i * cols()],
-											 &_matrix[i * cols()], &right._matrix[i * cols()] ,
-											 cols()));
-			}
-			else
-			{
-				// if our parallel is not true then just calculate row by row without threads
-				addRows(&additionMatrix._matrix[i * cols()],
-						&_matrix[i * cols()], &right._matrix[i * cols()] , cols());
+			return a * b;
+		});
+	}
 
-			}
-		}
+	/**
+	 * @brief Transposes the current matrix on the shared pool. The matrix is copied when the
+	 * operation is started, so it may change or go away while it runs.
+	 * @return a future of the transposed matrix
+	 */
+	MatrixFuture<Matrix<T>> transAsync() const
+	{
+		std :: shared_ptr<const Matrix<T>> self = std :: make_shared<const Matrix<T>>(*this);
+		return MatrixFuture<Matrix<T>> :: run([self]() { return self->trans(); });
+	}
 
-		// go over the threads and  join them when the function ends.
-		for(unsigned int i = 0; i < threadVector.size(); ++i)
+	/**
+	 * @brief Adds the values of two futures once both are ready, without blocking.
+	 * @param future of the left operand
+	 * @param future of the right operand
+	 * @return a future of the sum
+	 */
+	static MatrixFuture<Matrix<T>> addAsync(const MatrixFuture<Matrix<T>> &left,
+											const MatrixFuture<Matrix<T>> &right)
+	{
+		return MatrixFuture<Matrix<T>> :: whenBoth(left, right,
+												   [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			threadVector[i].join();
-		}
-		return additionMatrix;
+			return a + b;
+		});
 	}
-    
-    /**
-     * @brief Overrides - operator for Matrix to subtract a matrix from the current matrix.
-     * @param Matrix we wish to subtract from the current matrix.
-     * @return a new Matrix we created
-     */
-    const Matrix<T> operator-(const Matrix<T> &right) const
+
+	/**
+	 * @brief Subtracts the values of two futures once both are ready, without blocking.
+	 * @param future of the left operand
+	 * @param future of the right operand
+	 * @return a future of the difference
+	 */
+	static MatrixFuture<Matrix<T>> subtractAsync(const MatrixFuture<Matrix<T>> &left,
+												 const MatrixFuture<Matrix<T>> &right)
 	{
-		if(rows() != right.rows() || cols() != right.cols())
+		return MatrixFuture<Matrix<T>> :: whenBoth(left, right,
+												   [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			throw BadDimensionException(OP_MESSAGE);
-		}
-		// create a new matrix and subtract the values of two other vectors and add to ours
-		Matrix<T> subtractionMatrix(rows(), cols());
-		for(unsigned int i = 0; i < _matrix.size() ; ++i)
-		{
-			subtractionMatrix._matrix[i] = _matrix[i] + right._matrix[i];
-		}
-		return subtractionMatrix;
+			return a - b;
+		});
 	}
-	
-	
+
 	/**
-	 * @brief Calculates the dot product between a row and column of valid sizes
-	 * @param pointer to begining of the row
-	 * @param pointer to the begining of the column
-	 * @param length of the row
-	 * @param length of the column
-	 * @return the dot product
+	 * @brief Multiplies the values of two futures once both are ready, without blocking.
+	 * @param future of the left operand
+	 * @param future of the right operand
+	 * @return a future of the product
 	 */
-	static T dotProduct(const T *firstArray, const T *secondArray,
-						unsigned int lengthRow, unsigned int lengthCol)
+	static MatrixFuture<Matrix<T>> multiplyAsync(const MatrixFuture<Matrix<T>> &left,
+												 const MatrixFuture<Matrix<T>> &right)
 	{
-		// create a new T object
-		T sum = T();
-		for(unsigned int i = 0; i < lengthRow; ++i)
+		return MatrixFuture<Matrix<T>> :: whenBoth(left, right,
+												   [](const Matrix<T>& a, const Matrix<T>& b)
 		{
-			// sum each row into that T object using it's operators
-			sum += firstArray[i] * secondArray[i * lengthCol];
-		}
-		return sum;
+			return a * b;
+		});
 	}
-	
-	
+
 	/**
-	 * @brief changes the value of each row in a inputted matrix by multiplying the row 
-	 * and column of the other inputted matrices
-	 * @param Matrix we wish to change
-	 * @param first matrix we are multiplying
-	 * @param second matrix we are multiplying
-	 * @param the row number
+	 * @brief Transposes the value of a future once it is ready, without blocking.
+	 * @param future of the matrix
+	 * @return a future of the transposed matrix
 	 */
-	static void rowMulti(Matrix<T>& change, const Matrix<T>& first, const Matrix<T>& sec, 
-						 unsigned int rowNum)
+	static MatrixFuture<Matrix<T>> transAsync(const MatrixFuture<Matrix<T>> &matrix)
 	{
-		// go over all the indexes in the row and call dot product to change them
-		for(unsigned int j = 0; j < change.cols(); ++j)
-		{
-			change._matrix[(rowNum * change.cols()) + j] = dotProduct(
-																		 &first._matrix
-																		 [rowNum * first.cols()],
-																		 &sec._matrix[j],
-																		 first.cols(),
-																		 sec.cols());
-		}
+		return matrix.then([](const Matrix<T>& a) { return a.trans(); });
 	}
-	
-    /**
-     * @brief Overrides * operator for Matrix to multiply a matrix by current matrix.
-     * @param Matrix we wish to multiply by the current matrix.
-     * @return a new Matrix we created
-     */
-    const Matrix<T> operator*(const Matrix<T> &other) const
+
+	/**
+	 * @brief Overrides == operator for Matrix to check whether a matrix is equal to another
+	 * @param Matrix we wish to check equality of
+	 * @return true if they are equal, false otherwise
+	 */
+	bool operator==(const Matrix<T> &right) const
 	{
-		if(cols() != other.rows())
+		if(rows() != right.rows() || cols() != right.cols())
 		{
-			throw BadDimensionException(OP_MESSAGE);
+			return false;
 		}
-		// initialize and empty matrix of the proper size and a vector of threads
-		Matrix<T> tmpMatrix(rows(), other.cols());
-		std :: vector<std :: thread> threadVector;
-		// initialize each index in that matrix to be the dot product between a row and column
-		for (unsigned int i = 0; i < tmpMatrix.rows(); ++i)
+		if(right._layout != _layout)
 		{
-			// if it was parallel use seperate threads for each row and put them in our vector
-			if (_parallel)
-			{
-				threadVector.push_back(std::thread(rowMulti, std::ref(tmpMatrix), std::ref (*this), 
-									   std::ref (other), i));
-			}
-			else
-			{
-				// otherwise just calculate the rows one by one
-				rowMulti(tmpMatrix, *this, other, i);
-			}
+			return *this == right.toLayout(_layout);
 		}
-		
-		// join all our threads before ending the function
-		for(unsigned int i = 0; i < threadVector.size(); ++i)
+		// copies sharing their cells are equal, except floating cells that may hold NaN
+		if(std :: is_integral<T> :: value && _data() == right._data())
 		{
-			threadVector[i].join();
+			return true;
 		}
-		
-		return tmpMatrix;
+		MATRIX_TRACE_SCOPE("equal", rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _allBlocks("equal", right, [](const T *left, const T *other, size_t length)
+		{
+			return _blockEqual(left, other, length, std :: is_integral<T>());
+		});
 	}
-	
+
 	/**
-	 * @brief Overrides == operator for Matrix to check whether a matrix is equal to another
+	 * @brief Overrides != operator for Matrix to check whether a matrix is unequal to another
 	 * @param Matrix we wish to check equality of
-	 * @return true if they are equal, false otherwise
+	 * @return true if they are unequal, false otherwise
 	 */
-	bool operator==(const Matrix<T> &right) const
+	bool operator!=(const Matrix<T> &right) const
+	{
+		// return the negation of our == operator
+		return !(*this == right);
+	}
+
+	/**
+	 * @brief Checks whether every cell is close to the cell of another matrix at the same
+	 * position, |a - b| <= absolute + relative * |b|. NaN is close to nothing. Stops every thread
+	 * at the first cell that is not.
+	 * @param Matrix we wish to compare to
+	 * @param tolerance relative to the cells of the other matrix
+	 * @param absolute tolerance
+	 * @return true if the dimensions match and all cells are close, false otherwise
+	 */
+	bool allClose(const Matrix<T> &right, double relative = 1e-5, double absolute = 1e-8) const
 	{
 		if(rows() != right.rows() || cols() != right.cols())
 		{
 			return false;
 		}
-		// check that each value in the Matrix equals the one in the inputted matrix
-		for(unsigned int i = 0; i < _matrix.size() ; ++i)
+		if(right._layout != _layout)
+		{
+			return allClose(right.toLayout(_layout), relative, absolute);
+		}
+		MATRIX_TRACE_SCOPE("allClose", rows(), cols(), 2 * (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		return _allBlocks("allClose", right, [=](const T *left, const T *other, size_t length)
 		{
-			if(	_matrix[i] != right._matrix[i])
+			bool close = true;
+			for(size_t i = 0; i < length; ++i)
 			{
-				return false;
+				close &= _distance(left[i], other[i]) <= absolute + relative * _magnitude(other[i]);
 			}
-
-		}
-		return true;
+			return close;
+		});
 	}
 
 	/**
-	 * @brief Overrides != operator for Matrix to check whether a matrix is unequal to another
-	 * @param Matrix we wish to check equality of
-	 * @return true if they are equal, false otherwise
+	 * @brief Hash of the dimensions and the cells, equal for equal matrices whatever their layout
+	 * and the number of threads computing it. Every cell is hashed with its row major position and
+	 * the hashes are added, so blocks of cells are hashed on the pool threads in parallel mode.
+	 * Computed on every call, store it to compare contents later without the cells.
+	 * @return the hash
 	 */
-	bool operator!=(const Matrix<T> &right) const
+	uint64_t hash() const
 	{
-		// return the negation of our == operator
-		return !this == right;
+		if(_layout != LAYOUT_ROW_MAJOR)
+		{
+			return toLayout(LAYOUT_ROW_MAJOR).hash();
+		}
+		MATRIX_TRACE_SCOPE("hash", rows(), cols(), (size_t)rows() * cols() * sizeof(T),
+						   _threadsUsed());
+		std :: atomic<uint64_t> sum(0);
+		std :: atomic<uint64_t> *total = &sum;
+		const T *cells = _data();
+		_forEachCell("hash", [=](size_t first, size_t last)
+		{
+			uint64_t partial = 0;
+			for(size_t i = first; i < last; ++i)
+			{
+				partial += _mixHash(_cellHash(cells[i]) ^ (i * HASH_GOLDEN));
+			}
+			*total += partial;
+		});
+		return _mixHash(sum ^ _mixHash(((uint64_t)rows() << 32) | cols()));
 	}
 	
 	/**
@@ -521,7 +2767,7 @@ public:
 		{
 			throw std :: out_of_range(INDEX_MESSAGE);
 		}
-		return _matrix[(rowPos - OFFSET) * cols() + colPos - OFFSET];
+		return _data()[_index(rowPos - OFFSET, colPos - OFFSET)];
 	}
 
 	/**
@@ -536,7 +2782,7 @@ public:
 		{
 			throw std :: out_of_range(INDEX_MESSAGE);
 		}
-		return _matrix[(rowPos - OFFSET) * cols() + colPos - OFFSET];
+		return _leakedData()[_index(rowPos - OFFSET, colPos - OFFSET)];
 	}
 	
 	
@@ -560,20 +2806,12 @@ public:
 		{
 			throw BadDimensionException(TRACE_MESSAGE);
 		}
-		// go index by index and when the row num equals the col num add that value to the sum
-		T sum = T();
-		for (unsigned int i = 1; i <= rows(); ++i) 
-		{
-			for(unsigned int j = 1; j <= cols(); ++j)
-			{
-				if (j == i)
-				{
-					sum += (*this)(i, j);
-				}
-			}
-		}
-		return sum;
-	
+		MATRIX_TRACE_SCOPE("trace", rows(), cols(), (size_t)rows() * sizeof(T), 1);
+		MATRIX_PERF_SCOPE("trace", rows());
+		// only the diagonal is read, summed pairwise like sum()
+		const T *cells = _data();
+		return _pairwise<T>(0, rows(), [this, cells](size_t i) { return cells[_index(i, i)]; },
+							[](const T& a, const T& b) { return T(a + b); });
 	}
 	
 	
@@ -583,15 +2821,11 @@ public:
      */
     Matrix<T> trans() const
 	{
-		// create a copy of our matrix and switch indexes so that it is transposed
-		Matrix<T> transMatrix(*this);
-		for (unsigned int i = 0; i < rows(); ++i)
-		{
-			for(unsigned int j = 0; j < cols(); ++j)
-			{
-				transMatrix._matrix[(j * rows()) + i] = (*this)(i + OFFSET, j + OFFSET);
-			}
-		}
+		MATRIX_TRACE_SCOPE("trans", cols(), rows(), 2 * (size_t)rows() * cols() * sizeof(T), 1);
+		MATRIX_PERF_SCOPE("trans", (size_t)rows() * cols());
+		// create a matrix of our size and switch indexes so that it is transposed
+		Matrix<T> transMatrix(rows(), cols(), _Uninitialized());
+		_transposeInto(transMatrix._mutableData(), [](const T& cell) { return cell; });
 
 		// change column and row values
 		transMatrix._setRow(cols());
@@ -608,8 +2842,9 @@ public:
 	}
 	
 	/**
-	 * @brief Matrix<T> iterator class which is basically a wrapper for a vector<T> iterator
-	 *
+	 * @brief Matrix<T> iterator class which is basically a wrapper for a pointer to the cells.
+	 * Cells are always visited in row major order, an iterator on a matrix of another layout
+	 * follows the position of the cell and looks up where it is stored.
 	 */
 	class const_iterator
 	{
@@ -618,19 +2853,30 @@ public:
 		/**
 		 * @brief Default constructor that sets our vector to nullptr
 		 */
-		const_iterator(): _pointer(nullptr)
+		const_iterator(): _pointer(nullptr), _owner(nullptr), _position(0)
 		{
 		}
 
 		/**
-		 * @brief Constructor that sets recieves an iterator on a vector and sets it
-		 * @param vector<T> iterator
+		 * @brief Constructor that recieves a pointer to a cell and sets it
+		 * @param pointer to a cell
 		 */
-		const_iterator(typename std :: vector<T> :: const_iterator def)
+		const_iterator(const T *def) : _owner(nullptr), _position(0)
 		{
 			
 			_pointer = def;
 		}
+
+		/**
+		 * @brief Constructor for a row major position in a matrix that is not row major
+		 * @param the matrix
+		 * @param row major position of the cell, rows() * cols() for the end
+		 */
+		const_iterator(const Matrix<T> *owner, size_t position) : _owner(owner),
+																   _position(position)
+		{
+			_seek();
+		}
 		
 		/**
 		 * @brief * operator that derefrences and iterator on our Matrix
@@ -648,7 +2894,7 @@ public:
 		 */
 		const T operator[](unsigned int i) const
 		{
-			return _pointer[i];
+			return _owner ? *const_iterator(_owner, _position + i) : _pointer[i];
 		}
 		
 		/**
@@ -657,7 +2903,15 @@ public:
 		 */
 		const_iterator& operator++()
 		{
-			_pointer = ++_pointer;
+			if(_owner)
+			{
+				++_position;
+				_seek();
+			}
+			else
+			{
+				++_pointer;
+			}
 			return *this;
 		}
 		
@@ -667,7 +2921,15 @@ public:
 		 */
 		const_iterator& operator--()
 		{
-			_pointer = --_pointer;
+			if(_owner)
+			{
+				--_position;
+				_seek();
+			}
+			else
+			{
+				--_pointer;
+			}
 			return *this;
 		}
 		
@@ -678,7 +2940,7 @@ public:
 		 */
 		bool operator==(const const_iterator& right) const
 		{
-			return _pointer == right.getPointer();
+			return _pointer == right.getPointer() && _position == right._position;
 		}
 		
 		/**
@@ -700,6 +2962,8 @@ public:
 		const_iterator& operator=(const const_iterator& right)
 		{
 			_pointer = right.getPointer();
+			_owner = right._owner;
+			_position = right._position;
 			return *this;
 		}
 		
@@ -707,14 +2971,27 @@ public:
 		 * @brief getter for the vector iterator variable we have
 		 * @return our iterator
 		 */
-		typename std :: vector<T> :: const_iterator getPointer() const
+		const T *getPointer() const
 		{
 			return _pointer;
 		}
 		
 	private:
+
+		/**
+		 * @brief Points at the cell of our row major position, nullptr past the last cell
+		 */
+		void _seek()
+		{
+			const size_t colAmnt = _owner->cols();
+			_pointer = _position < (size_t)_owner->rows() * colAmnt ?
+					   _owner->_data() + _owner->_index(_position / colAmnt, _position % colAmnt) :
+					   nullptr;
+		}
 		
-		typename std :: vector<T> :: const_iterator _pointer; /** iterator of vector<T> which represents the matrix */
+		const T *_pointer; /** pointer to the current cell of the matrix */
+		const Matrix<T> *_owner; /** matrix of another layout we follow, nullptr if row major */
+		size_t _position; /** row major position of the cell when following a matrix */
 	};
 	
 	/**
@@ -723,7 +3000,7 @@ public:
 	 */	
 	const_iterator begin() const
 	{
-		return const_iterator(_matrix.begin());
+		return _layout == LAYOUT_ROW_MAJOR ? const_iterator(_data()) : const_iterator(this, 0);
 	}
 	
 	/**
@@ -732,7 +3009,9 @@ public:
 	 */
 	const_iterator end() const
 	{
-		return const_iterator(_matrix.end());
+		const size_t cellAmnt = (size_t)rows() * cols();
+		return _layout == LAYOUT_ROW_MAJOR ? const_iterator(_data() + cellAmnt) :
+											 const_iterator(this, cellAmnt);
 	}
 	
 };
@@ -741,6 +3020,10 @@ public:
 template<typename U>
 bool Matrix<U> :: _parallel = false;
 
+// and our static copy on write variable
+template<typename U>
+bool Matrix<U> :: _sharing = false;
+
 
 /**
  * @brief Overrides << operator for Matrix to print a matrix.
@@ -751,12 +3034,17 @@ bool Matrix<U> :: _parallel = false;
 template<typename U>
 std :: ostream& operator<< (std :: ostream& os, const Matrix<U>& ourMatrix)
 {
-	// for each row and column go index by index and add to our stream with proper spacing
-	for (unsigned int i = 1; i <= ourMatrix.rows(); ++i)
+	if(ourMatrix._layout != LAYOUT_ROW_MAJOR)
+	{
+		return os << ourMatrix.toLayout(LAYOUT_ROW_MAJOR);
+	}
+	// go over the cells in order, adding each to our stream with proper spacing
+	const U *cell = ourMatrix._data();
+	for (unsigned int i = 0; i < ourMatrix.rows(); ++i)
 	{
-		for(unsigned int j = 1; j <= ourMatrix.cols(); ++j)
+		for(unsigned int j = 0; j < ourMatrix.cols(); ++j)
 		{
-			os << ourMatrix(i, j) << (PRINT_TAB);
+			os << *cell++ << (PRINT_TAB);
 		}
 		os << (PRINT_NEW_LINE);
 	}
@@ -764,6 +3052,63 @@ std :: ostream& operator<< (std :: ostream& os, const Matrix<U>& ourMatrix)
 	return os;
 }
 
+template<typename U>
+std :: istream& operator>> (std :: istream& is, Matrix<U>& ourMatrix)
+{
+	// gather the lines of the matrix into one text and parse it like a file
+	std :: vector<char> text;
+	std :: string line;
+	while(std :: getline(is, line) && line.find_first_not_of(" \t,\r") != std :: string :: npos)
+	{
+		text.insert(text.end(), line.begin(), line.end());
+		text.push_back('\n');
+	}
+	if(text.empty())
+	{
+		is.setstate(std :: ios :: failbit);
+		return is;
+	}
+	// reaching the end of the stream after the last row is not a failure
+	if(is.eof())
+	{
+		is.clear(std :: ios :: eofbit);
+	}
+	text.push_back('\0');
+	try
+	{
+		ourMatrix = Matrix<U> :: _parseText(text, "stream");
+	}
+	catch (std :: runtime_error &e)
+	{
+		is.setstate(std :: ios :: failbit);
+	}
+	return is;
+}
+
+/**
+ * @brief Overrides + operator to add a matrix to a scalar, cell by cell.
+ * @param the scalar
+ * @param Matrix we add
+ * @return a new Matrix we created
+ */
+template <typename U>
+const Matrix<U> operator+(const U& scalar, const Matrix<U>& ourMatrix)
+{
+	return ourMatrix.map([scalar](const U& cell) { return scalar + cell; });
+}
+
+/**
+ * @brief Overrides * operator to multiply a scalar by a matrix, cell by cell.
+ * @param the scalar
+ * @param Matrix we multiply
+ * @return a new Matrix we created
+ */
+template <typename U>
+const Matrix<U> operator*(const U& scalar, const Matrix<U>& ourMatrix)
+{
+	return ourMatrix.map([scalar](const U& cell) { return scalar * cell; });
+}
+
 /**
  * @brief Deep copy swaps between two matrixes
  * @param first matrix
@@ -776,9 +3121,24 @@ void swap(Matrix<U>& first, Matrix<U>& second)
 	std :: swap(first._colNum, second._colNum);
 	std :: swap(first._rowNum, second._rowNum);
 	std :: swap(first._matrix, second._matrix);
+	std :: swap(first._inline, second._inline);
+	std :: swap(first._mapping, second._mapping);
+	std :: swap(first._shared, second._shared);
+	std :: swap(first._layout, second._layout);
 }
 
 
+/**
+ * @brief Specialized template function of the transposed cell, the conjugate for complex numbers
+ * @param the cell
+ * @return the conjugate of the cell
+ */
+template<>
+inline Complex Matrix<Complex> :: _transCell(const Complex& cell)
+{
+	return cell.conj();
+}
+
 /**
  * @brief Specialized template function trans which returns the conjugate transpose for complex
  * number Matrices
@@ -787,18 +3147,135 @@ void swap(Matrix<U>& first, Matrix<U>& second)
 template<>
 Matrix<Complex> Matrix<Complex> :: trans() const
 {
-	// create a copy of our matrix and switch indexes so that it is transposed
-	Matrix<Complex> transMatrix(*this);
-	for (unsigned int i = 1; i <= rows(); ++i)
-	{
-		for(unsigned int j = 1; j <= cols(); ++j)
-		{
-			transMatrix._matrix[((j -OFFSET) * rows()) + i - OFFSET] = (*this)(i, j).conj();
-		}
-	}
+	MATRIX_TRACE_SCOPE("trans", cols(), rows(), 2 * (size_t)rows() * cols() * sizeof(Complex), 1);
+	MATRIX_PERF_SCOPE("trans", (size_t)rows() * cols());
+	// create a matrix of our size and switch indexes so that it is transposed and conjugated
+	Matrix<Complex> transMatrix(rows(), cols(), _Uninitialized());
+	_transposeInto(transMatrix._mutableData(), [](const Complex& cell) { return cell.conj(); });
 	// change column and row values
 	transMatrix._setRow(cols());
 	transMatrix._setCol(rows());
 	return transMatrix;
 }
+/**
+ * @brief Splits complex cells into planes of real numbers: the real parts, the imaginary parts
+ * times a sign and the sums of both
+ * @param the cells
+ * @param number of cells
+ * @param sign of the imaginary parts, -1 for the conjugates
+ * @param three planes of count numbers each
+ */
+inline void splitComplexPlanes(const Complex *cells, size_t count, double sign, double *planes)
+{
+	double *real = planes;
+	double *imag = planes + count;
+	double *sum = planes + 2 * count;
+	for(size_t i = 0; i < count; ++i)
+	{
+		real[i] = cells[i].getReal();
+		imag[i] = sign * cells[i].getImag();
+		sum[i] = real[i] + imag[i];
+	}
+}
+
+/**
+ * @brief Specialized template function of the blocked product for complex numbers, using the 3M
+ * method. With A = Ar + i Ai and B = Br + i Bi split into planes of doubles, the real blocked
+ * kernel takes the three products P1 = Ar Br, P2 = Ai Bi and P3 = (Ar + Ai)(Br + Bi), and
+ * AB = P1 - P2 + i (P3 - P1 - P2): three real multiplications per complex product instead of
+ * four. For the conjugate transpose the imaginary plane of A is negated and read transposed.
+ * @see _multiplyBlocked
+ */
+template<>
+inline Matrix<Complex> Matrix<Complex> :: _multiplyBlocked(const Matrix<Complex> &other,
+														   bool adjoint) const
+{
+	const size_t rowAmnt = adjoint ? cols() : rows();
+	const size_t depth = other.rows();
+	const size_t colAmnt = other.cols();
+	const size_t leftCells = (size_t)rows() * cols();
+	const size_t rightCells = depth * colAmnt;
+	const size_t resultCells = rowAmnt * colAmnt;
+	MATRIX_TRACE_SCOPE(adjoint ? "conjTransMultiply" : "multiply", rowAmnt, colAmnt,
+					   (leftCells + rightCells + resultCells) * sizeof(Complex), _threadsUsed());
+	Matrix<Complex> product(rowAmnt, colAmnt, _Uninitialized());
+	std :: vector<double, MatrixAllocator<double>> planes;
+	try
+	{
+		planes.resize(3 * (leftCells + rightCells + resultCells));
+	}
+	catch (std :: bad_alloc &e)
+	{
+		BAD_ALLOC_PRINT;
+		throw;
+	}
+	double *left = planes.data();
+	double *right = left + 3 * leftCells;
+	double *partial = right + 3 * rightCells;
+	splitComplexPlanes(_data(), leftCells, adjoint ? -1 : 1, left);
+	splitComplexPlanes(other._data(), rightCells, 1, right);
+
+	size_t rowStride = _layout == LAYOUT_ROW_MAJOR ? cols() : 1;
+	size_t depthStride = _layout == LAYOUT_ROW_MAJOR ? 1 : rows();
+	if(adjoint)
+	{
+		std :: swap(rowStride, depthStride);
+	}
+	const unsigned int tile = Matrix<double> :: _tuning(KERNEL_MULTIPLY).tile;
+	Complex *result = product._mutableData();
+	_forEachRow(_tuning(KERNEL_MULTIPLY), adjoint ? "conjTransMultiply" : "multiply",
+				resultCells, rowAmnt, 3 * rightCells, tile, [=](size_t first, size_t last)
+	{
+		for(size_t plane = 0; plane < 3; ++plane)
+		{
+			double *out = partial + plane * resultCells;
+			std :: fill(out + first * colAmnt, out + last * colAmnt, 0.0);
+			Matrix<double> :: _blockMulti(out, left + plane * leftCells, right + plane * rightCells,
+										  first, last, depth, colAmnt, tile, rowStride,
+										  depthStride);
+		}
+		const double *real = partial;
+		const double *imag = partial + resultCells;
+		const double *sum = partial + 2 * resultCells;
+		for(size_t i = first * colAmnt; i < last * colAmnt; ++i)
+		{
+			result[i] = Complex(real[i] - imag[i], sum[i] - real[i] - imag[i]);
+		}
+	});
+	return product;
+}
+
+/**
+ * @brief Specialized template function of the distance of complex cells, |a - b|
+ * @see _distance
+ */
+template<>
+inline double Matrix<Complex> :: _distance(const Complex& first, const Complex& second)
+{
+	return std :: hypot(first.getReal() - second.getReal(), first.getImag() - second.getImag());
+}
+
+/**
+ * @brief Specialized template function of the magnitude of complex cells, |a|
+ * @see _magnitude
+ */
+template<>
+inline double Matrix<Complex> :: _magnitude(const Complex& cell)
+{
+	return std :: hypot(cell.getReal(), cell.getImag());
+}
+
+/**
+ * @brief Specialized template function of the hash of complex cells, of both parts with zeros
+ * hashed as +0
+ * @see _cellHash
+ */
+template<>
+inline uint64_t Matrix<Complex> :: _cellHash(const Complex& cell)
+{
+	const double parts[] = {cell.getReal() == 0 ? 0.0 : cell.getReal(),
+							cell.getImag() == 0 ? 0.0 : cell.getImag()};
+	return _bytesHash(parts, sizeof(parts));
+}
+
 #endif
@@ -0,0 +1,147 @@
+/********************************************************************************
+ * @file MatrixAllocator.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix allocator header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix allocator.
+ *
+ * The allocator of the cells of a Matrix. It differs from std :: allocator in two ways:
+ *  - cells start on a cache line, so rows of tiles never share a line with another buffer
+ *  - growing a vector without a value default initializes the new cells instead of value
+ *    initializing them, so a buffer of plain numbers is not written at all when it is allocated.
+ *    The first thread to write a page then decides on which NUMA node the page lives.
+ *
+ * With -DMATRIX_MEMORY every buffer is counted by MatrixMemory (see MatrixMemory.h).
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws std :: bad_alloc when memory runs out, like std :: allocator, or when a buffer would go
+ * past the limit of MatrixMemory.
+ ********************************************************************************/
+
+#ifndef MATRIX_ALLOCATOR_H
+#define MATRIX_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include "MatrixMemory.h"
+
+/*
+ * @def CACHE_LINE
+ * @brief alignment in bytes of every cell buffer
+ */
+#define CACHE_LINE 64
+
+/**
+ * @brief Cache line aligned allocator that default initializes
+ */
+template <typename T>
+class MatrixAllocator
+{
+public:
+
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef MatrixAllocator<U> other;
+	};
+
+	MatrixAllocator()
+	{
+	}
+
+	template <typename U>
+	MatrixAllocator(const MatrixAllocator<U>&)
+	{
+	}
+
+	/**
+	 * @brief Allocates room for cells without constructing them
+	 * @param number of cells
+	 * @return pointer to the first cell
+	 */
+	T *allocate(size_t amount)
+	{
+		void *memory = nullptr;
+		size_t alignment = alignof(T) > CACHE_LINE ? alignof(T) : CACHE_LINE;
+		if(amount > static_cast<size_t>(-1) / sizeof(T))
+		{
+			throw std :: bad_alloc();
+		}
+		// counted before the system is asked, so a buffer past the limit is never allocated
+		MATRIX_MEMORY_ALLOC(T, amount * sizeof(T));
+		if(::posix_memalign(&memory, alignment, amount * sizeof(T)) != 0)
+		{
+			MATRIX_MEMORY_FAILED(T, amount * sizeof(T));
+			throw std :: bad_alloc();
+		}
+		return static_cast<T *>(memory);
+	}
+
+	/**
+	 * @brief Frees cells allocated by allocate
+	 * @param pointer to the first cell
+	 * @param number of cells
+	 */
+	void deallocate(T *cells, size_t amount)
+	{
+		MATRIX_MEMORY_FREE(T, amount * sizeof(T));
+		std :: free(cells);
+	}
+
+	/**
+	 * @brief Default initializes a cell, which leaves a plain number unwritten
+	 * @param the cell
+	 */
+	template <typename U>
+	void construct(U *cell)
+	{
+		::new(static_cast<void *>(cell)) U;
+	}
+
+	/**
+	 * @brief Constructs a cell from arguments
+	 * @param the cell
+	 * @param the arguments of the constructor
+	 */
+	template <typename U, typename... Args>
+	void construct(U *cell, Args&&... args)
+	{
+		::new(static_cast<void *>(cell)) U(std :: forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Destroys a cell
+	 * @param the cell
+	 */
+	template <typename U>
+	void destroy(U *cell)
+	{
+		cell->~U();
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const MatrixAllocator<T>&, const MatrixAllocator<U>&)
+{
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const MatrixAllocator<T>&, const MatrixAllocator<U>&)
+{
+	return false;
+}
+
+#endif
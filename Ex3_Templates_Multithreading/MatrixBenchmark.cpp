@@ -0,0 +1,382 @@
+/********************************************************************************
+ * @file MatrixBenchmark.cpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief Benchmark driver for the Matrix.hpp file
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * Benchmark that times the Matrix operations over a sweep of sizes, element types and modes.
+ *
+ * Every combination of size, element type (int, double, Complex), operation (add, sub, mul,
+ * trans) and mode (sequential, parallel) is timed a number of repetitions. For each combination
+ * the mean, median and 99th percentile of the time are printed together with the GFLOP/s and
+ * GB/s they amount to, and all results are written to a JSON file so runs can be compared.
+ *
+ * When built with -DMATRIX_PERF the hardware counters of every operation and size class are
+ * printed after the timings and written to the JSON file under "counters". When built with
+ * -DMATRIX_MEMORY the memory held by the matrices of every element type is printed as well.
+ *
+ * With -t the benchmark instead runs the calibration sweep of MatrixTuner.hpp for every element
+ * type and writes the tuned parameters to a profile, which Matrix reads at startup when it is
+ * named by MATRIX_PROFILE or is matrix_profile.txt in the working directory.
+ *
+ * Usage: MatrixBenchmark [-s size,size,...] [-r repetitions] [-o results.json] [-t profile]
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Prints usage and exits with a failure code on unknown arguments or a file that cannot be
+ * written.
+ ********************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Matrix.hpp"
+#include "MatrixTuner.hpp"
+
+/*
+ * @def DEF_SIZES
+ * @brief sizes of the square matrices benchmarked by default, the small and big sets of README
+ */
+#define DEF_SIZES "16,128,512"
+
+/*
+ * @def DEF_REPS
+ * @brief number of times each combination is timed by default
+ */
+#define DEF_REPS 5
+
+/*
+ * @def DEF_OUTPUT
+ * @brief file the JSON results are written to by default
+ */
+#define DEF_OUTPUT "benchmark.json"
+
+/*
+ * @def P99
+ * @brief the percentile reported next to the median
+ */
+#define P99 0.99
+
+/*
+ * @def GIGA
+ * @brief one billion, to report flops and bytes in giga units
+ */
+#define GIGA 1e9
+
+/*
+ * @def USAGE
+ * @brief usage message
+ */
+#define USAGE "Usage: MatrixBenchmark [-s size,size,...] [-r repetitions] [-o results.json] " \
+			  "[-t profile]"
+
+/*
+ * @def WRITE_ERROR
+ * @brief message for a results file that cannot be written
+ */
+#define WRITE_ERROR "Cannot write results to "
+
+/**
+ * @brief Timings and throughput of one combination
+ */
+struct BenchmarkResult
+{
+	std :: string type; /**< Name of the element type. */
+	std :: string op; /**< Name of the operation. */
+	std :: string mode; /**< Sequential or parallel. */
+	unsigned int size; /**< Dimension of the square operands. */
+	unsigned int reps; /**< Number of timed repetitions. */
+	double mean; /**< Mean time in seconds. */
+	double median; /**< Median time in seconds. */
+	double p99; /**< 99th percentile time in seconds. */
+	double gflops; /**< Giga floating point operations per second at the median. */
+	double gbytes; /**< Gigabytes touched per second at the median. */
+};
+
+/**
+ * @brief Number of arithmetic operations on built in numbers one element operation takes
+ */
+template <typename T>
+struct ElementFlops
+{
+	static const int add = 1; /**< flops of a + b */
+	static const int mul = 1; /**< flops of a * b */
+};
+
+/**
+ * @brief A complex addition is two real additions, a complex product four multiplications and
+ * two additions
+ */
+template <>
+struct ElementFlops<Complex>
+{
+	static const int add = 2; /**< flops of a + b */
+	static const int mul = 6; /**< flops of a * b */
+};
+
+/**
+ * @brief Builds a size x size matrix of small pseudo random values
+ * @param dimension
+ * @return the matrix
+ */
+template <typename T>
+Matrix<T> randomMatrix(unsigned int size)
+{
+	std :: vector<T> cells;
+	cells.reserve((size_t)size * size);
+	for(size_t i = 0; i < (size_t)size * size; ++i)
+	{
+		cells.push_back(T(std :: rand() % 10));
+	}
+	return Matrix<T>(size, size, cells);
+}
+
+/**
+ * @brief Value of a sorted vector at a percentile
+ * @param sorted times
+ * @param percentile between 0 and 1
+ * @return the time at that percentile
+ */
+static double percentile(const std :: vector<double>& sorted, double fraction)
+{
+	size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+	return sorted[std :: min(index, sorted.size() - 1)];
+}
+
+/**
+ * @brief Times an operation and summarizes the times
+ * @param callable running the operation once
+ * @param repetitions
+ * @param flops of one run
+ * @param bytes touched by one run
+ * @param result to fill the times and throughput of
+ */
+template <typename F>
+static void timeOperation(F operation, unsigned int reps, double flops, double bytes,
+						  BenchmarkResult& result)
+{
+	// one untimed run to fault in the pages and start the pool
+	operation();
+	std :: vector<double> times;
+	for(unsigned int i = 0; i < reps; ++i)
+	{
+		std :: chrono :: steady_clock :: time_point begin = std :: chrono :: steady_clock :: now();
+		operation();
+		times.push_back(std :: chrono :: duration<double>(std :: chrono :: steady_clock :: now() -
+														  begin).count());
+	}
+	std :: sort(times.begin(), times.end());
+	double sum = 0;
+	for(unsigned int i = 0; i < times.size(); ++i)
+	{
+		sum += times[i];
+	}
+	result.reps = reps;
+	result.mean = sum / times.size();
+	result.median = percentile(times, 0.5);
+	result.p99 = percentile(times, P99);
+	result.gflops = result.median > 0 ? flops / result.median / GIGA : 0;
+	result.gbytes = result.median > 0 ? bytes / result.median / GIGA : 0;
+}
+
+/**
+ * @brief Benchmarks every operation and mode for one element type and size
+ * @param name of the element type
+ * @param dimension
+ * @param repetitions
+ * @param vector to append the results to
+ */
+template <typename T>
+static void benchmarkType(const std :: string& type, unsigned int size, unsigned int reps,
+						  std :: vector<BenchmarkResult>& results)
+{
+	Matrix<T> first = randomMatrix<T>(size);
+	Matrix<T> second = randomMatrix<T>(size);
+	const double cells = (double)size * size;
+	const double cellBytes = cells * sizeof(T);
+	const char *modes[] = {NON_PARALLEL, PARALLEL};
+	for(int mode = 0; mode < 2; ++mode)
+	{
+		Matrix<T> :: setParallel(mode == 1);
+		BenchmarkResult result;
+		result.type = type;
+		result.mode = modes[mode];
+		result.size = size;
+
+		result.op = "add";
+		timeOperation([&]() { return first + second; }, reps, cells * ElementFlops<T> :: add,
+					  3 * cellBytes, result);
+		results.push_back(result);
+
+		result.op = "sub";
+		timeOperation([&]() { return first - second; }, reps, cells * ElementFlops<T> :: add,
+					  3 * cellBytes, result);
+		results.push_back(result);
+
+		// every cell of the product is a dot product of size multiplications and additions, and
+		// reads a row of the first and a column of the second
+		result.op = "mul";
+		timeOperation([&]() { return first * second; }, reps,
+					  cells * size * (ElementFlops<T> :: mul + ElementFlops<T> :: add),
+					  cells * size * 2 * sizeof(T) + cellBytes, result);
+		results.push_back(result);
+
+		result.op = "trans";
+		timeOperation([&]() { return first.trans(); }, reps, 0, 2 * cellBytes, result);
+		results.push_back(result);
+	}
+}
+
+/**
+ * @brief Prints a result as a row of the results table
+ * @param the result
+ */
+static void printResult(const BenchmarkResult& result)
+{
+	std :: cout << std :: left << std :: setw(8) << result.type << std :: setw(7) << result.op
+				<< std :: setw(14) << result.mode << std :: right << std :: setw(6) << result.size
+				<< std :: setw(14) << result.mean << std :: setw(14) << result.median
+				<< std :: setw(14) << result.p99 << std :: setw(10) << result.gflops
+				<< std :: setw(10) << result.gbytes << std :: endl;
+}
+
+/**
+ * @brief Writes all results as a JSON document
+ * @param stream to write to
+ * @param the results
+ */
+static void writeJson(std :: ostream& os, const std :: vector<BenchmarkResult>& results)
+{
+	os << "{\n  \"threads\": " << ThreadPool :: shared().size() << ",\n  \"results\": [\n";
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		os << "    {\"type\": \"" << result.type << "\", \"op\": \"" << result.op
+		   << "\", \"mode\": \"" << result.mode << "\", \"size\": " << result.size
+		   << ", \"reps\": " << result.reps << ", \"mean_s\": " << result.mean
+		   << ", \"median_s\": " << result.median << ", \"p99_s\": " << result.p99
+		   << ", \"gflops\": " << result.gflops << ", \"gbytes_per_s\": " << result.gbytes << "}"
+		   << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	os << "  ]";
+#ifdef MATRIX_PERF
+	os << ",\n  \"counters\": ";
+	MatrixPerf :: instance().writeJson(os);
+#endif
+	os << "\n}\n";
+}
+
+/**
+ * @brief Parses a comma separated list of sizes
+ * @param the list
+ * @return the sizes
+ */
+static std :: vector<unsigned int> parseSizes(const std :: string& list)
+{
+	std :: vector<unsigned int> sizes;
+	std :: stringstream stream(list);
+	std :: string token;
+	while(std :: getline(stream, token, ','))
+	{
+		sizes.push_back(std :: atoi(token.c_str()));
+	}
+	return sizes;
+}
+
+/**
+ * @brief Main that parses the arguments, runs the sweep and writes the results
+ */
+int main(int argc, char *argv[])
+{
+	std :: vector<unsigned int> sizes = parseSizes(DEF_SIZES);
+	unsigned int reps = DEF_REPS;
+	std :: string output = DEF_OUTPUT;
+	std :: string profile;
+	for(int i = 1; i < argc; ++i)
+	{
+		std :: string flag = argv[i];
+		if(i + 1 < argc && flag == "-s")
+		{
+			sizes = parseSizes(argv[++i]);
+		}
+		else if(i + 1 < argc && flag == "-r")
+		{
+			reps = std :: max(1, std :: atoi(argv[++i]));
+		}
+		else if(i + 1 < argc && flag == "-o")
+		{
+			output = argv[++i];
+		}
+		else if(i + 1 < argc && flag == "-t")
+		{
+			profile = argv[++i];
+		}
+		else
+		{
+			std :: cerr << USAGE << std :: endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(!profile.empty())
+	{
+		tuneMatrix<int>(std :: cout);
+		tuneMatrix<double>(std :: cout);
+		tuneMatrix<Complex>(std :: cout);
+		if(!MatrixTuning :: instance().save(profile))
+		{
+			std :: cerr << WRITE_ERROR << profile << std :: endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	std :: vector<BenchmarkResult> results;
+	for(size_t i = 0; i < sizes.size(); ++i)
+	{
+		benchmarkType<int>("int", sizes[i], reps, results);
+		benchmarkType<double>("double", sizes[i], reps, results);
+		benchmarkType<Complex>("Complex", sizes[i], reps, results);
+	}
+
+	std :: cout << std :: left << std :: setw(8) << "type" << std :: setw(7) << "op"
+				<< std :: setw(14) << "mode" << std :: right << std :: setw(6) << "size"
+				<< std :: setw(14) << "mean(s)" << std :: setw(14) << "median(s)"
+				<< std :: setw(14) << "p99(s)" << std :: setw(10) << "GFLOP/s"
+				<< std :: setw(10) << "GB/s" << std :: endl;
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		printResult(results[i]);
+	}
+
+#ifdef MATRIX_PERF
+	std :: cout << std :: endl;
+	MatrixPerf :: instance().writeReport(std :: cout);
+#endif
+
+#ifdef MATRIX_MEMORY
+	std :: cout << std :: endl;
+	MatrixMemory :: instance().writeReport(std :: cout);
+#endif
+
+	std :: ofstream json(output.c_str());
+	writeJson(json, results);
+	if(!json)
+	{
+		std :: cerr << WRITE_ERROR << output << std :: endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
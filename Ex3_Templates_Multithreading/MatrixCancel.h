@@ -0,0 +1,275 @@
+/********************************************************************************
+ * @file MatrixCancel.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix cancellation header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix cancellation token.
+ *
+ * A MatrixCancellation stops the Matrix operations run under it when it is cancelled or its
+ * deadline passes. A token is made current for a thread by a MatrixCancellation :: Scope, and
+ * is carried over to the pool threads that run the operations started under it, and to the
+ * tasks of the futures created under it.
+ *
+ * The kernels check the token between blocks of rows, of about a chunk of work each. Once it is
+ * cancelled every block not yet started is dropped, so the threads are free again after the
+ * blocks they are running. The token counts the work of the operations run under it and the
+ * work finished, so the progress made before a cancellation can be reported.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * An operation that is stopped throws MatrixCancelledException, holding the progress made.
+ ********************************************************************************/
+
+#ifndef MATRIX_CANCEL_H
+#define MATRIX_CANCEL_H
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+
+/*
+ * @def CANCEL_MESSAGE
+ * @brief print message for an operation stopped by its token
+ */
+#define CANCEL_MESSAGE "Matrix operation cancelled."
+
+/**
+ * @brief Exception of an operation stopped by a cancellation token
+ */
+class MatrixCancelledException : public std :: exception
+{
+public:
+
+	/**
+	 * @brief constructor receives the progress of the operations of the token
+	 * @param units of work finished
+	 * @param units of work started
+	 */
+	MatrixCancelledException(size_t done, size_t total) : _done(done), _total(total)
+	{
+	}
+
+	/**
+	 * @brief returns our message overrides std:: exception:: what()
+	 * @return our message
+	 */
+	const char* what() const noexcept override
+	{
+		return CANCEL_MESSAGE;
+	}
+
+	/**
+	 * @brief Getter for the units of work finished before the operations were stopped
+	 * @return the finished work
+	 */
+	size_t done() const
+	{
+		return _done;
+	}
+
+	/**
+	 * @brief Getter for the units of work of the operations started under the token
+	 * @return the total work
+	 */
+	size_t total() const
+	{
+		return _total;
+	}
+
+private:
+
+	size_t _done; /**< Units of work finished. */
+	size_t _total; /**< Units of work started. */
+};
+
+/**
+ * @brief Token that stops the Matrix operations run under it once cancelled or past a deadline
+ */
+class MatrixCancellation
+{
+public:
+
+	typedef std :: chrono :: steady_clock Clock;
+
+	/**
+	 * @brief Makes a token current for the calling thread while it exists, and restores the
+	 * token that was current before
+	 */
+	class Scope
+	{
+	public:
+
+		/**
+		 * @brief Makes a token current
+		 * @param the token, nullptr for none
+		 */
+		explicit Scope(const std :: shared_ptr<MatrixCancellation>& token) : _previous(_current())
+		{
+			_current() = token;
+		}
+
+		/**
+		 * @brief Restores the token that was current before
+		 */
+		~Scope()
+		{
+			_current() = _previous;
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+
+		std :: shared_ptr<MatrixCancellation> _previous; /**< Token current before. */
+	};
+
+	/**
+	 * @brief Default constructor of a token without a deadline
+	 */
+	MatrixCancellation() : _cancelled(false), _deadline(NO_DEADLINE), _done(0), _total(0)
+	{
+	}
+
+	/**
+	 * @brief Creates a token that cancels itself after a timeout
+	 * @param time from now to the deadline
+	 * @return the token
+	 */
+	static std :: shared_ptr<MatrixCancellation> withTimeout(Clock :: duration timeout)
+	{
+		std :: shared_ptr<MatrixCancellation> token = std :: make_shared<MatrixCancellation>();
+		token->setDeadline(Clock :: now() + timeout);
+		return token;
+	}
+
+	/**
+	 * @brief Getter for the token current for the calling thread
+	 * @return the token, nullptr if there is none
+	 */
+	static const std :: shared_ptr<MatrixCancellation>& current()
+	{
+		return _current();
+	}
+
+	/**
+	 * @brief Cancels the operations run under the token
+	 */
+	void cancel()
+	{
+		_cancelled = true;
+	}
+
+	/**
+	 * @brief Sets the time after which the token is cancelled
+	 * @param the deadline
+	 */
+	void setDeadline(Clock :: time_point deadline)
+	{
+		_deadline = deadline.time_since_epoch().count();
+	}
+
+	/**
+	 * @brief Checks whether the token is cancelled, cancelling it if its deadline passed
+	 * @return true if cancelled, false otherwise
+	 */
+	bool cancelled()
+	{
+		if(!_cancelled && _deadline != NO_DEADLINE &&
+		   Clock :: now().time_since_epoch().count() >= _deadline)
+		{
+			_cancelled = true;
+		}
+		return _cancelled;
+	}
+
+	/**
+	 * @brief Stops the calling operation if the token is cancelled
+	 */
+	void check()
+	{
+		if(cancelled())
+		{
+			throw MatrixCancelledException(_done, _total);
+		}
+	}
+
+	/**
+	 * @brief Adds the work of an operation started under the token
+	 * @param units of work
+	 */
+	void addWork(size_t work)
+	{
+		_total += work;
+	}
+
+	/**
+	 * @brief Adds work finished by an operation run under the token
+	 * @param units of work
+	 */
+	void addDone(size_t work)
+	{
+		_done += work;
+	}
+
+	/**
+	 * @brief Getter for the units of work finished, cell operations for the Matrix kernels
+	 * @return the finished work
+	 */
+	size_t done() const
+	{
+		return _done;
+	}
+
+	/**
+	 * @brief Getter for the units of work of the operations started under the token
+	 * @return the total work
+	 */
+	size_t total() const
+	{
+		return _total;
+	}
+
+	/**
+	 * @brief Getter for the fraction of the work started that is finished
+	 * @return the fraction, 1 when no work was started
+	 */
+	double progress() const
+	{
+		const size_t total = _total;
+		return total == 0 ? 1 : (double)_done / total;
+	}
+
+private:
+
+	/*
+	 * @brief deadline of a token that has none
+	 */
+	static const Clock :: rep NO_DEADLINE = 0;
+
+	/**
+	 * @brief The token current for the calling thread
+	 * @return reference to it
+	 */
+	static std :: shared_ptr<MatrixCancellation>& _current()
+	{
+		static thread_local std :: shared_ptr<MatrixCancellation> token;
+		return token;
+	}
+
+	std :: atomic<bool> _cancelled; /**< Whether the token is cancelled. */
+	std :: atomic<Clock :: rep> _deadline; /**< Ticks of the deadline, NO_DEADLINE for none. */
+	std :: atomic<size_t> _done; /**< Units of work finished. */
+	std :: atomic<size_t> _total; /**< Units of work started. */
+};
+
+#endif
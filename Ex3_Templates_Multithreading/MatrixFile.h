@@ -0,0 +1,441 @@
+/********************************************************************************
+ * @file MatrixFile.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix binary file header.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix binary container.
+ *
+ * A matrix file is a fixed size header followed by the raw cells of the matrix. The header
+ * records the element type, the dimensions, the layout of the cells and the alignment of the
+ * cell block, so a file can be mapped into memory and used in place without parsing.
+ *
+ * The same container can be held by a POSIX shared memory object instead of a file, so several
+ * processes map one copy of a matrix. Shared memory objects are named like "/name".
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws std :: runtime_error when a file or shared memory object cannot be opened, created,
+ * mapped or is not a matrix file.
+ ********************************************************************************/
+
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class Complex;
+
+/*
+ * @def MATRIX_FILE_MAGIC
+ * @brief the four bytes every matrix file starts with
+ */
+#define MATRIX_FILE_MAGIC "MTXB"
+
+/*
+ * @def MATRIX_FILE_VERSION
+ * @brief version of the header written by this implementation
+ */
+#define MATRIX_FILE_VERSION 1
+
+/*
+ * @def MATRIX_FILE_ENDIAN
+ * @brief tag written in native byte order, read back to detect foreign endianness
+ */
+#define MATRIX_FILE_ENDIAN 0x01020304u
+
+/*
+ * @def MATRIX_FILE_ALIGNMENT
+ * @brief alignment in bytes of the cell block inside the file (a cache line)
+ */
+#define MATRIX_FILE_ALIGNMENT 64
+
+/*
+ * @def OPEN_FILE_MESSAGE
+ * @brief error message for a file that could not be opened
+ */
+#define OPEN_FILE_MESSAGE "Cannot open matrix file: "
+
+/*
+ * @def MAP_FILE_MESSAGE
+ * @brief error message for a file that could not be mapped
+ */
+#define MAP_FILE_MESSAGE "Cannot map matrix file: "
+
+/*
+ * @def BAD_FILE_MESSAGE
+ * @brief error message for a file whose header is not valid
+ */
+#define BAD_FILE_MESSAGE "Not a valid matrix file: "
+
+/*
+ * @def DTYPE_FILE_MESSAGE
+ * @brief error message for a file holding a different element type than requested
+ */
+#define DTYPE_FILE_MESSAGE "Matrix file element type does not match: "
+
+/*
+ * @def SHARED_FILE_MODE
+ * @brief permissions of the shared memory objects we create, written by us and read by anyone
+ */
+#define SHARED_FILE_MODE 0644
+
+/*
+ * @def CREATE_SHARED_MESSAGE
+ * @brief error message for a shared memory object that could not be created
+ */
+#define CREATE_SHARED_MESSAGE "Cannot create shared matrix: "
+
+/**
+ * @brief Codes of the element types a matrix file can hold
+ */
+enum MatrixDataType : uint32_t
+{
+	DTYPE_UNKNOWN = 0,
+	DTYPE_INT8,
+	DTYPE_UINT8,
+	DTYPE_INT16,
+	DTYPE_UINT16,
+	DTYPE_INT32,
+	DTYPE_UINT32,
+	DTYPE_INT64,
+	DTYPE_UINT64,
+	DTYPE_FLOAT,
+	DTYPE_DOUBLE,
+	DTYPE_COMPLEX
+};
+
+/**
+ * @brief Codes of the cell orders a matrix file can hold
+ */
+enum MatrixFileLayout : uint32_t
+{
+	FILE_ROW_MAJOR = 0
+};
+
+/**
+ * @brief Maps an element type to its file code. Types without a code are stored as
+ * DTYPE_UNKNOWN and are only checked by element size when read back.
+ */
+template <typename T>
+struct MatrixDataTypeOf
+{
+	static const uint32_t value = DTYPE_UNKNOWN;
+};
+
+#define MATRIX_DTYPE(type, code) \
+template <> struct MatrixDataTypeOf<type> { static const uint32_t value = code; };
+
+MATRIX_DTYPE(int8_t, DTYPE_INT8)
+MATRIX_DTYPE(uint8_t, DTYPE_UINT8)
+MATRIX_DTYPE(int16_t, DTYPE_INT16)
+MATRIX_DTYPE(uint16_t, DTYPE_UINT16)
+MATRIX_DTYPE(int32_t, DTYPE_INT32)
+MATRIX_DTYPE(uint32_t, DTYPE_UINT32)
+MATRIX_DTYPE(int64_t, DTYPE_INT64)
+MATRIX_DTYPE(uint64_t, DTYPE_UINT64)
+MATRIX_DTYPE(float, DTYPE_FLOAT)
+MATRIX_DTYPE(double, DTYPE_DOUBLE)
+MATRIX_DTYPE(Complex, DTYPE_COMPLEX)
+
+#undef MATRIX_DTYPE
+
+/**
+ * @brief The header at the start of every matrix file. All fields are fixed width so the header
+ * has the same size and offsets on every platform.
+ */
+struct MatrixFileHeader
+{
+	char magic[4]; /**< Always MATRIX_FILE_MAGIC. */
+	uint32_t version; /**< Header version, MATRIX_FILE_VERSION. */
+	uint32_t endian; /**< MATRIX_FILE_ENDIAN in the byte order of the writer. */
+	uint32_t dtype; /**< One of MatrixDataType. */
+	uint32_t elemSize; /**< sizeof of a single cell in bytes. */
+	uint32_t layout; /**< One of MatrixFileLayout. */
+	uint64_t rows; /**< Row dimension. */
+	uint64_t cols; /**< Column dimension. */
+	uint64_t alignment; /**< Alignment in bytes of the cell block. */
+	uint64_t dataOffset; /**< Offset in bytes of the first cell from the start of the file. */
+	uint64_t reserved[2]; /**< Zero, kept for future fields. */
+
+	/**
+	 * @brief Builds the header describing a rows x cols matrix of T
+	 * @param row dimension
+	 * @param column dimension
+	 * @return a filled header
+	 */
+	template <typename T>
+	static MatrixFileHeader describe(uint64_t rowAmnt, uint64_t colAmnt)
+	{
+		MatrixFileHeader header;
+		std :: memset(&header, 0, sizeof(header));
+		std :: memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+		header.version = MATRIX_FILE_VERSION;
+		header.endian = MATRIX_FILE_ENDIAN;
+		header.dtype = MatrixDataTypeOf<T> :: value;
+		header.elemSize = sizeof(T);
+		header.layout = FILE_ROW_MAJOR;
+		header.rows = rowAmnt;
+		header.cols = colAmnt;
+		header.alignment = MATRIX_FILE_ALIGNMENT;
+		// round the end of the header up to the next aligned offset
+		header.dataOffset = ((sizeof(MatrixFileHeader) + MATRIX_FILE_ALIGNMENT - 1) /
+							 MATRIX_FILE_ALIGNMENT) * MATRIX_FILE_ALIGNMENT;
+		return header;
+	}
+
+	/**
+	 * @brief Number of bytes the cell block takes
+	 * @return size of the cells in bytes
+	 */
+	uint64_t dataSize() const
+	{
+		return rows * cols * elemSize;
+	}
+
+	/**
+	 * @brief Checks that this header was written by a compatible writer
+	 * @return true if the header can be read, false otherwise
+	 */
+	bool isValid() const
+	{
+		return std :: memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0 &&
+			   version == MATRIX_FILE_VERSION && endian == MATRIX_FILE_ENDIAN &&
+			   layout == FILE_ROW_MAJOR && elemSize != 0 &&
+			   dataOffset >= sizeof(MatrixFileHeader) &&
+			   (alignment == 0 || dataOffset % alignment == 0);
+	}
+
+	/**
+	 * @brief Checks that the cell block lies inside a file of the given length. The sizes are
+	 * divided before they are compared, so a header with huge dimensions cannot wrap around.
+	 * Must only be called on a valid header.
+	 * @param length of the file in bytes
+	 * @return true if every cell is inside the file, false otherwise
+	 */
+	bool fits(uint64_t length) const
+	{
+		if(dataOffset > length)
+		{
+			return false;
+		}
+		const uint64_t cells = (length - dataOffset) / elemSize;
+		return rows == 0 || cols <= cells / rows;
+	}
+};
+
+/**
+ * @brief A read only memory mapping of a matrix file. The mapping lives as long as this object,
+ * so matrices that use it hold it through a shared pointer.
+ */
+class MappedMatrixFile
+{
+public:
+
+	/**
+	 * @brief Opens and maps a matrix file and validates its header
+	 * @param path of the file
+	 */
+	explicit MappedMatrixFile(const std :: string& path) :
+		MappedMatrixFile(::open(path.c_str(), O_RDONLY), path)
+	{
+	}
+
+	/**
+	 * @brief Maps an open matrix file or shared memory object and validates its header
+	 * @param descriptor opened for reading, closed by the constructor
+	 * @param name of the file for error messages
+	 */
+	MappedMatrixFile(int fd, const std :: string& path) :
+		_path(path), _base(nullptr), _length(0), _device(0), _inode(0)
+	{
+		if(fd < 0)
+		{
+			throw std :: runtime_error(OPEN_FILE_MESSAGE + path);
+		}
+		struct stat info;
+		if(::fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MatrixFileHeader))
+		{
+			::close(fd);
+			throw std :: runtime_error(BAD_FILE_MESSAGE + path);
+		}
+		_length = info.st_size;
+		_device = info.st_dev;
+		_inode = info.st_ino;
+		void *base = ::mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+		// the mapping keeps its own reference to the file
+		::close(fd);
+		if(base == MAP_FAILED)
+		{
+			throw std :: runtime_error(MAP_FILE_MESSAGE + path);
+		}
+		_base = static_cast<const char *>(base);
+		std :: memcpy(&_header, _base, sizeof(_header));
+		if(!_header.isValid() || !_header.fits(_length))
+		{
+			::munmap(const_cast<char *>(_base), _length);
+			throw std :: runtime_error(BAD_FILE_MESSAGE + path);
+		}
+		// we expect to stream through the cells, let the kernel read ahead
+		::madvise(const_cast<char *>(_base), _length, MADV_WILLNEED);
+	}
+
+	/**
+	 * @brief Unmaps the file
+	 */
+	~MappedMatrixFile()
+	{
+		if(_base != nullptr)
+		{
+			::munmap(const_cast<char *>(_base), _length);
+		}
+	}
+
+	MappedMatrixFile(const MappedMatrixFile&) = delete;
+	MappedMatrixFile& operator=(const MappedMatrixFile&) = delete;
+
+	/**
+	 * @brief Maps a shared memory object holding a matrix file read only
+	 * @param name of the object
+	 * @return the mapping
+	 */
+	static std :: shared_ptr<const MappedMatrixFile> openShared(const std :: string& name)
+	{
+		return std :: make_shared<const MappedMatrixFile>(::shm_open(name.c_str(), O_RDONLY, 0),
+														  name);
+	}
+
+	/**
+	 * @brief Getter for the path of the file, or the name of the shared memory object
+	 * @return the path
+	 */
+	const std :: string& path() const
+	{
+		return _path;
+	}
+
+	/**
+	 * @brief Checks whether a path names this same file, through any link to it
+	 * @param path to check
+	 * @return true if the path is this file, false otherwise or if there is no such file
+	 */
+	bool isFile(const std :: string& path) const
+	{
+		struct stat theirs;
+		return ::stat(path.c_str(), &theirs) == 0 && theirs.st_dev == _device &&
+			   theirs.st_ino == _inode;
+	}
+
+	/**
+	 * @brief Getter for the header of the file
+	 * @return the header
+	 */
+	const MatrixFileHeader& header() const
+	{
+		return _header;
+	}
+
+	/**
+	 * @brief Checks whether the file holds cells of type T
+	 * @return true if the cells can be read as T, false otherwise
+	 */
+	template <typename T>
+	bool holds() const
+	{
+		return _header.elemSize == sizeof(T) && _header.dtype == MatrixDataTypeOf<T> :: value;
+	}
+
+	/**
+	 * @brief Getter for the cells of the file
+	 * @return pointer to the first cell
+	 */
+	template <typename T>
+	const T *cells() const
+	{
+		return reinterpret_cast<const T *>(_base + _header.dataOffset);
+	}
+
+	/**
+	 * @brief Getter for the whole mapped file, header included
+	 * @return pointer to the first byte
+	 */
+	const char *bytes() const
+	{
+		return _base;
+	}
+
+	/**
+	 * @brief Getter for the length of the mapped file
+	 * @return length in bytes
+	 */
+	size_t length() const
+	{
+		return _length;
+	}
+
+private:
+
+	std :: string _path; /**< Path of the file, for error messages. */
+	const char *_base; /**< Start of the mapping. */
+	size_t _length; /**< Length of the mapping in bytes. */
+	MatrixFileHeader _header; /**< Copy of the header of the file. */
+	dev_t _device; /**< Device of the file, to recognise it under another path. */
+	ino_t _inode; /**< Inode of the file, to recognise it under another path. */
+};
+
+/**
+ * @brief Creates a shared memory object holding a matrix file. The cells are written once,
+ * through a mapping that is dropped before returning, so readers only ever map it read only.
+ * @param name of the object, must not exist yet
+ * @param header of the file
+ * @param the cells in row major order, header.dataSize() bytes of them
+ */
+inline void writeSharedMatrixFile(const std :: string& name, const MatrixFileHeader& header,
+								  const void *cells)
+{
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, SHARED_FILE_MODE);
+	if(fd < 0)
+	{
+		throw std :: runtime_error(CREATE_SHARED_MESSAGE + name);
+	}
+	const size_t length = header.dataOffset + header.dataSize();
+	void *base = ::ftruncate(fd, length) == 0 ?
+				 ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if(base == MAP_FAILED)
+	{
+		::shm_unlink(name.c_str());
+		throw std :: runtime_error(CREATE_SHARED_MESSAGE + name);
+	}
+	// the padding between the header and the cells is already zero
+	std :: memcpy(base, &header, sizeof(header));
+	std :: memcpy(static_cast<char *>(base) + header.dataOffset, cells, header.dataSize());
+	::munmap(base, length);
+}
+
+/**
+ * @brief Removes the name of a shared memory object. Processes that mapped it keep their
+ * mappings, the memory is freed once the last of them is gone.
+ * @param name of the object
+ * @return true if it was removed, false if there was none
+ */
+inline bool unlinkSharedMatrixFile(const std :: string& name)
+{
+	return ::shm_unlink(name.c_str()) == 0;
+}
+
+#endif
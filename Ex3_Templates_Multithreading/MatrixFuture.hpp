@@ -0,0 +1,295 @@
+/********************************************************************************
+ * @file MatrixFuture.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard MatrixFuture header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard MatrixFuture header.
+ *
+ * This header provides a handle to a value computed on the shared ThreadPool. Unlike
+ * std :: future, a MatrixFuture can be chained: then() and whenBoth() register work to run once
+ * the value is ready, without blocking any thread while waiting. The cancellation token current
+ * when a task is registered is current again while the task runs.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * An exception thrown while computing a value is stored and rethrown by get(). Work chained on
+ * a failed future is skipped and the failure is passed on to the chained future.
+ ********************************************************************************/
+
+#ifndef MATRIX_FUTURE_H
+#define MATRIX_FUTURE_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "MatrixCancel.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief Handle to a value of type R that is being computed on the shared ThreadPool.
+ * Copies of a MatrixFuture refer to the same value.
+ */
+template <typename R>
+class MatrixFuture
+{
+	template <typename U>
+	friend class MatrixFuture;
+
+public:
+
+	/**
+	 * @brief Default constructor of a future that refers to no value
+	 */
+	MatrixFuture()
+	{
+	}
+
+	/**
+	 * @brief Runs a callable on the shared pool
+	 * @param callable returning R
+	 * @return a future of the value returned by the callable
+	 */
+	template <typename F>
+	static MatrixFuture<R> run(F task)
+	{
+		MatrixFuture<R> result(std :: make_shared<_State>());
+		std :: shared_ptr<_State> state = result._state;
+		std :: shared_ptr<MatrixCancellation> token = MatrixCancellation :: current();
+		ThreadPool :: shared().submit([state, task, token]()
+		{
+			MatrixCancellation :: Scope scope(token);
+			state->compute(task);
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Wraps a value that is already known
+	 * @param the value
+	 * @return a ready future holding the value
+	 */
+	static MatrixFuture<R> ready(R value)
+	{
+		MatrixFuture<R> result(std :: make_shared<_State>());
+		result._state->setValue(std :: move(value));
+		return result;
+	}
+
+	/**
+	 * @brief Checks whether this future refers to a value
+	 * @return true if it does, false otherwise
+	 */
+	bool valid() const
+	{
+		return static_cast<bool>(_state);
+	}
+
+	/**
+	 * @brief Checks whether the value is computed, without blocking
+	 * @return true if get() would not block, false otherwise
+	 */
+	bool isReady() const
+	{
+		std :: lock_guard<std :: mutex> lock(_state->mutex);
+		return _state->done;
+	}
+
+	/**
+	 * @brief Blocks until the value is computed
+	 */
+	void wait() const
+	{
+		std :: unique_lock<std :: mutex> lock(_state->mutex);
+		_state->finished.wait(lock, [this]() { return _state->done; });
+	}
+
+	/**
+	 * @brief Blocks until the value is computed and returns it
+	 * @return the value, valid as long as a future referring to it exists
+	 */
+	const R& get() const
+	{
+		wait();
+		if(_state->error)
+		{
+			std :: rethrow_exception(_state->error);
+		}
+		return *_state->value;
+	}
+
+	/**
+	 * @brief Chains a callable to run on the shared pool once the value is ready
+	 * @param callable receiving a const R&
+	 * @return a future of the value returned by the callable
+	 */
+	template <typename F>
+	MatrixFuture<typename std :: result_of<F(const R&)> :: type> then(F task) const
+	{
+		typedef typename std :: result_of<F(const R&)> :: type Next;
+		MatrixFuture<Next> result(std :: make_shared<typename MatrixFuture<Next> :: _State>());
+		std :: shared_ptr<typename MatrixFuture<Next> :: _State> next = result._state;
+		std :: shared_ptr<_State> state = _state;
+		std :: shared_ptr<MatrixCancellation> token = MatrixCancellation :: current();
+		_state->onReady([state, next, task, token]()
+		{
+			if(state->error)
+			{
+				next->setError(state->error);
+				return;
+			}
+			MatrixCancellation :: Scope scope(token);
+			next->compute([state, task]() { return task(*state->value); });
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Chains a callable to run on the shared pool once the values of two futures are ready
+	 * @param first future
+	 * @param second future
+	 * @param callable receiving a const R& and a const U&
+	 * @return a future of the value returned by the callable
+	 */
+	template <typename U, typename F>
+	static MatrixFuture<typename std :: result_of<F(const R&, const U&)> :: type>
+	whenBoth(const MatrixFuture<R>& first, const MatrixFuture<U>& second, F task)
+	{
+		typedef typename std :: result_of<F(const R&, const U&)> :: type Next;
+		MatrixFuture<Next> result(std :: make_shared<typename MatrixFuture<Next> :: _State>());
+		std :: shared_ptr<typename MatrixFuture<Next> :: _State> next = result._state;
+		std :: shared_ptr<_State> left = first._state;
+		std :: shared_ptr<typename MatrixFuture<U> :: _State> right = second._state;
+		std :: shared_ptr<MatrixCancellation> token = MatrixCancellation :: current();
+		// wait for the first value, then chain on the second one from inside the continuation
+		left->onReady([left, right, next, task, token]()
+		{
+			if(left->error)
+			{
+				next->setError(left->error);
+				return;
+			}
+			right->onReady([left, right, next, task, token]()
+			{
+				if(right->error)
+				{
+					next->setError(right->error);
+					return;
+				}
+				MatrixCancellation :: Scope scope(token);
+				next->compute([left, right, task]()
+				{
+					return task(*left->value, *right->value);
+				});
+			});
+		});
+		return result;
+	}
+
+private:
+
+	/**
+	 * @brief The value shared between copies of a future and the task computing it
+	 */
+	struct _State
+	{
+		_State() : done(false)
+		{
+		}
+
+		/**
+		 * @brief Runs a callable and stores its value or its exception
+		 */
+		template <typename F>
+		void compute(F task)
+		{
+			try
+			{
+				setValue(task());
+			}
+			catch (...)
+			{
+				setError(std :: current_exception());
+			}
+		}
+
+		/**
+		 * @brief Stores the value and schedules the chained work
+		 */
+		void setValue(R result)
+		{
+			value.reset(new R(std :: move(result)));
+			_finish();
+		}
+
+		/**
+		 * @brief Stores an exception and schedules the chained work
+		 */
+		void setError(std :: exception_ptr exception)
+		{
+			error = exception;
+			_finish();
+		}
+
+		/**
+		 * @brief Runs a callable on the pool once this state is done
+		 */
+		void onReady(std :: function<void()> continuation)
+		{
+			{
+				std :: lock_guard<std :: mutex> lock(mutex);
+				if(!done)
+				{
+					continuations.push_back(std :: move(continuation));
+					return;
+				}
+			}
+			ThreadPool :: shared().submit(std :: move(continuation));
+		}
+
+		std :: unique_ptr<R> value; /**< The value, once computed. */
+		std :: exception_ptr error; /**< The exception thrown while computing, if any. */
+		bool done; /**< Whether value or error is set. */
+		std :: mutex mutex; /**< Guards done and continuations. */
+		std :: condition_variable finished; /**< Signalled when done becomes true. */
+		std :: vector<std :: function<void()>> continuations; /**< Work waiting on this value. */
+
+	private:
+
+		void _finish()
+		{
+			std :: vector<std :: function<void()>> waiting;
+			{
+				std :: lock_guard<std :: mutex> lock(mutex);
+				done = true;
+				waiting.swap(continuations);
+			}
+			finished.notify_all();
+			for(unsigned int i = 0; i < waiting.size(); ++i)
+			{
+				ThreadPool :: shared().submit(std :: move(waiting[i]));
+			}
+		}
+	};
+
+	/**
+	 * @brief Constructor from a shared state
+	 */
+	explicit MatrixFuture(std :: shared_ptr<_State> state) : _state(state)
+	{
+	}
+
+	std :: shared_ptr<_State> _state; /**< The shared value, null for a default constructed future. */
+};
+
+#endif
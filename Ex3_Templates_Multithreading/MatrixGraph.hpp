@@ -0,0 +1,490 @@
+/********************************************************************************
+ * @file MatrixGraph.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard MatrixGraph header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard MatrixGraph header.
+ *
+ * This header provides a recorder for computations made of many Matrix operations. Each
+ * operation is a node of a dependency graph. Running the graph starts every node as soon as its
+ * operands are ready, so independent nodes run at the same time on the shared ThreadPool, and
+ * every intermediate matrix is freed as soon as its last consumer is done with it.
+ *
+ * After a run the graph reports the peak memory its matrices took, the wall time and the length
+ * of the critical path, the longest chain of dependent nodes.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws BadDimensionException when recording a node whose operand dimensions don't match, and
+ * std :: out_of_range for an unknown node. An exception thrown by a node during run() stops the
+ * nodes that were not started yet and is rethrown by run().
+ ********************************************************************************/
+
+#ifndef MATRIX_GRAPH_H
+#define MATRIX_GRAPH_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "BadDimensionException.h"
+#include "Matrix.hpp"
+#include "ThreadPool.h"
+
+/*
+ * @def NODE_MESSAGE
+ * @brief print message for a node that is not in the graph
+ */
+#define NODE_MESSAGE "Node is not in the graph."
+
+/*
+ * @def GRAPH_OP_MESSAGE
+ * @brief print message for recording an operation on nodes of wrong dimensions
+ */
+#define GRAPH_OP_MESSAGE "Wrong dimensions for this graph operation."
+
+/**
+ * @brief Statistics of the last run of a MatrixGraph
+ */
+struct MatrixGraphStats
+{
+	size_t peakBytes; /**< Most bytes held by node results at the same time. */
+	double wallSeconds; /**< Time from the start of the run until the last node finished. */
+	double criticalPathSeconds; /**< Sum of the node times along the longest dependency chain. */
+	std :: vector<double> nodeSeconds; /**< Time each node took, by node. */
+};
+
+/**
+ * @brief A dependency graph of Matrix operations that is recorded first and then run.
+ */
+template <typename T>
+class MatrixGraph
+{
+public:
+
+	typedef size_t Node; /**< Handle of a node, valid for the graph that created it. */
+
+	/**
+	 * @brief Records an input of the graph. The matrix is not copied, it must outlive every run.
+	 * @param the input matrix
+	 * @return its node
+	 */
+	Node input(const Matrix<T>& matrix)
+	{
+		_Node node(_INPUT, matrix.rows(), matrix.cols());
+		node.source = &matrix;
+		return _push(node);
+	}
+
+	/**
+	 * @brief Records the sum of two nodes
+	 * @return the node of the sum
+	 */
+	Node add(Node left, Node right)
+	{
+		_checkSameSize(left, right);
+		return _push(_binary(_ADD, left, right, _at(left).rows, _at(left).cols));
+	}
+
+	/**
+	 * @brief Records the difference of two nodes
+	 * @return the node of the difference
+	 */
+	Node subtract(Node left, Node right)
+	{
+		_checkSameSize(left, right);
+		return _push(_binary(_SUBTRACT, left, right, _at(left).rows, _at(left).cols));
+	}
+
+	/**
+	 * @brief Records the product of two nodes
+	 * @return the node of the product
+	 */
+	Node multiply(Node left, Node right)
+	{
+		if(_at(left).cols != _at(right).rows)
+		{
+			throw BadDimensionException(GRAPH_OP_MESSAGE);
+		}
+		return _push(_binary(_MULTIPLY, left, right, _at(left).rows, _at(right).cols));
+	}
+
+	/**
+	 * @brief Records the transpose of a node
+	 * @return the node of the transposed matrix
+	 */
+	Node trans(Node operand)
+	{
+		_Node node(_TRANS, _at(operand).cols, _at(operand).rows);
+		node.operands.push_back(operand);
+		return _push(node);
+	}
+
+	/**
+	 * @brief Marks a node as an output, so its result is kept after the run
+	 * @param the node
+	 */
+	void output(Node node)
+	{
+		_at(node).isOutput = true;
+	}
+
+	/**
+	 * @brief Getter for the result of an output node of the last run
+	 * @param the node
+	 * @return its matrix
+	 */
+	const Matrix<T>& result(Node node) const
+	{
+		const _Node& ourNode = _at(node);
+		if(ourNode.op == _INPUT)
+		{
+			return *ourNode.source;
+		}
+		if(!ourNode.result)
+		{
+			throw std :: out_of_range(NODE_MESSAGE);
+		}
+		return *ourNode.result;
+	}
+
+	/**
+	 * @brief Getter for the statistics of the last run
+	 * @return the statistics
+	 */
+	const MatrixGraphStats& stats() const
+	{
+		return _stats;
+	}
+
+	/**
+	 * @brief Runs every node of the graph and returns once all are done
+	 */
+	void run()
+	{
+		_Run state(_nodes.size());
+		_run = &state;
+		_start = std :: chrono :: steady_clock :: now();
+		_stats.peakBytes = 0;
+		_stats.nodeSeconds.assign(_nodes.size(), 0);
+		for(size_t i = 0; i < _nodes.size(); ++i)
+		{
+			_nodes[i].result.reset();
+			_nodes[i].pending = _nodes[i].operands.size();
+			_nodes[i].consumersLeft = _nodes[i].consumers.size();
+		}
+		// the inputs are ready at once, finishing them starts every node that only depends on them
+		for(size_t i = 0; i < _nodes.size(); ++i)
+		{
+			if(_nodes[i].op == _INPUT)
+			{
+				_schedule(i);
+			}
+		}
+		std :: unique_lock<std :: mutex> lock(state.mutex);
+		state.finished.wait(lock, [&state]() { return state.left == 0; });
+		lock.unlock();
+
+		_stats.wallSeconds = _seconds(_start, std :: chrono :: steady_clock :: now());
+		_stats.peakBytes = state.peakBytes;
+		_stats.criticalPathSeconds = 0;
+		std :: vector<double> longest(_nodes.size(), 0);
+		for(size_t i = 0; i < _nodes.size(); ++i)
+		{
+			// nodes are recorded after their operands, so one pass in order finds the longest chain
+			double before = 0;
+			for(size_t j = 0; j < _nodes[i].operands.size(); ++j)
+			{
+				before = std :: max(before, longest[_nodes[i].operands[j]]);
+			}
+			longest[i] = before + _stats.nodeSeconds[i];
+			_stats.criticalPathSeconds = std :: max(_stats.criticalPathSeconds, longest[i]);
+		}
+		_run = nullptr;
+		if(state.error)
+		{
+			std :: rethrow_exception(state.error);
+		}
+	}
+
+	/**
+	 * @brief Default constructor of an empty graph
+	 */
+	MatrixGraph() : _run(nullptr)
+	{
+		_stats.peakBytes = 0;
+		_stats.wallSeconds = 0;
+		_stats.criticalPathSeconds = 0;
+	}
+
+private:
+
+	/**
+	 * @brief Operations a node can run
+	 */
+	enum _Op
+	{
+		_INPUT,
+		_ADD,
+		_SUBTRACT,
+		_MULTIPLY,
+		_TRANS
+	};
+
+	/**
+	 * @brief A recorded operation and the state it has during a run
+	 */
+	struct _Node
+	{
+		_Node(_Op nodeOp, unsigned int rowAmnt, unsigned int colAmnt) : op(nodeOp), rows(rowAmnt),
+			cols(colAmnt), source(nullptr), isOutput(false), pending(0), consumersLeft(0)
+		{
+		}
+
+		_Node(const _Node& other) : op(other.op), rows(other.rows), cols(other.cols),
+			operands(other.operands), consumers(other.consumers), source(other.source),
+			isOutput(other.isOutput), pending(0), consumersLeft(0)
+		{
+		}
+
+		_Op op; /**< What the node computes. */
+		unsigned int rows; /**< Row dimension of the result. */
+		unsigned int cols; /**< Column dimension of the result. */
+		std :: vector<Node> operands; /**< Nodes whose results this node reads. */
+		std :: vector<Node> consumers; /**< Nodes that read the result of this node. */
+		const Matrix<T> *source; /**< The matrix of an input node. */
+		bool isOutput; /**< Whether the result is kept after the run. */
+		std :: shared_ptr<Matrix<T>> result; /**< Result of the node while it is needed. */
+		std :: atomic<size_t> pending; /**< Operands not computed yet during a run. */
+		std :: atomic<size_t> consumersLeft; /**< Consumers not done yet during a run. */
+	};
+
+	/**
+	 * @brief Bookkeeping of one call to run()
+	 */
+	struct _Run
+	{
+		explicit _Run(size_t nodeAmnt) : left(nodeAmnt), liveBytes(0), peakBytes(0)
+		{
+		}
+
+		std :: mutex mutex; /**< Guards left, error and the byte counts. */
+		std :: condition_variable finished; /**< Signalled when left reaches zero. */
+		size_t left; /**< Nodes not finished yet. */
+		size_t liveBytes; /**< Bytes held by node results right now. */
+		size_t peakBytes; /**< Most bytes held by node results so far. */
+		std :: exception_ptr error; /**< First exception thrown by a node. */
+	};
+
+	/**
+	 * @brief Builds a node with two operands
+	 */
+	static _Node _binary(_Op op, Node left, Node right, unsigned int rowAmnt, unsigned int colAmnt)
+	{
+		_Node node(op, rowAmnt, colAmnt);
+		node.operands.push_back(left);
+		node.operands.push_back(right);
+		return node;
+	}
+
+	/**
+	 * @brief Adds a node and registers it as a consumer of its operands
+	 */
+	Node _push(const _Node& node)
+	{
+		Node id = _nodes.size();
+		_nodes.push_back(node);
+		for(size_t i = 0; i < node.operands.size(); ++i)
+		{
+			_nodes[node.operands[i]].consumers.push_back(id);
+		}
+		return id;
+	}
+
+	/**
+	 * @brief Getter for a node that checks it exists
+	 */
+	_Node& _at(Node node)
+	{
+		if(node >= _nodes.size())
+		{
+			throw std :: out_of_range(NODE_MESSAGE);
+		}
+		return _nodes[node];
+	}
+
+	/**
+	 * @brief Getter for a node that checks it exists
+	 */
+	const _Node& _at(Node node) const
+	{
+		if(node >= _nodes.size())
+		{
+			throw std :: out_of_range(NODE_MESSAGE);
+		}
+		return _nodes[node];
+	}
+
+	/**
+	 * @brief Throws if two nodes don't have the same dimensions
+	 */
+	void _checkSameSize(Node left, Node right)
+	{
+		if(_at(left).rows != _at(right).rows || _at(left).cols != _at(right).cols)
+		{
+			throw BadDimensionException(GRAPH_OP_MESSAGE);
+		}
+	}
+
+	/**
+	 * @brief Getter for the matrix a node produced during the current run
+	 */
+	const Matrix<T>& _value(Node node) const
+	{
+		return _nodes[node].op == _INPUT ? *_nodes[node].source : *_nodes[node].result;
+	}
+
+	/**
+	 * @brief Number of bytes the result of a node takes
+	 */
+	size_t _bytes(Node node) const
+	{
+		return _nodes[node].op == _INPUT ? 0 : (size_t)_nodes[node].rows * _nodes[node].cols *
+																					sizeof(T);
+	}
+
+	/**
+	 * @brief Seconds between two points in time
+	 */
+	static double _seconds(std :: chrono :: steady_clock :: time_point from,
+						   std :: chrono :: steady_clock :: time_point to)
+	{
+		return std :: chrono :: duration<double>(to - from).count();
+	}
+
+	/**
+	 * @brief Runs a node on the shared pool. Input nodes have nothing to compute and finish at once.
+	 */
+	void _schedule(Node node)
+	{
+		if(_nodes[node].op == _INPUT)
+		{
+			_finish(node, 0);
+			return;
+		}
+		ThreadPool :: shared().submit([this, node]()
+		{
+			_compute(node);
+		});
+	}
+
+	/**
+	 * @brief Computes the result of a node, or skips it if an earlier node failed
+	 */
+	void _compute(Node node)
+	{
+		_Node& ourNode = _nodes[node];
+		bool failed;
+		{
+			std :: lock_guard<std :: mutex> lock(_run->mutex);
+			failed = static_cast<bool>(_run->error);
+		}
+		std :: chrono :: steady_clock :: time_point begin = std :: chrono :: steady_clock :: now();
+		if(!failed)
+		{
+			try
+			{
+				{
+					// count the result as soon as it is allocated
+					std :: lock_guard<std :: mutex> lock(_run->mutex);
+					_run->liveBytes += _bytes(node);
+					_run->peakBytes = std :: max(_run->peakBytes, _run->liveBytes);
+				}
+				switch(ourNode.op)
+				{
+					case _ADD:
+						ourNode.result.reset(new Matrix<T>(_value(ourNode.operands[0]) +
+														   _value(ourNode.operands[1])));
+						break;
+					case _SUBTRACT:
+						ourNode.result.reset(new Matrix<T>(_value(ourNode.operands[0]) -
+														   _value(ourNode.operands[1])));
+						break;
+					case _MULTIPLY:
+						ourNode.result.reset(new Matrix<T>(_value(ourNode.operands[0]) *
+														   _value(ourNode.operands[1])));
+						break;
+					default:
+						ourNode.result.reset(new Matrix<T>(_value(ourNode.operands[0]).trans()));
+						break;
+				}
+			}
+			catch (...)
+			{
+				std :: lock_guard<std :: mutex> lock(_run->mutex);
+				if(!_run->error)
+				{
+					_run->error = std :: current_exception();
+				}
+			}
+		}
+		_finish(node, _seconds(begin, std :: chrono :: steady_clock :: now()));
+	}
+
+	/**
+	 * @brief Releases the operands this node was the last consumer of, and starts the consumers
+	 * of this node that have all their operands now
+	 */
+	void _finish(Node node, double seconds)
+	{
+		_Node& ourNode = _nodes[node];
+		_stats.nodeSeconds[node] = seconds;
+		for(size_t i = 0; i < ourNode.operands.size(); ++i)
+		{
+			_Node& operand = _nodes[ourNode.operands[i]];
+			if(--operand.consumersLeft == 0 && !operand.isOutput && operand.op != _INPUT)
+			{
+				operand.result.reset();
+				std :: lock_guard<std :: mutex> lock(_run->mutex);
+				_run->liveBytes -= _bytes(ourNode.operands[i]);
+			}
+		}
+		// a result nobody reads and nobody asked for is dropped at once
+		if(ourNode.consumers.empty() && !ourNode.isOutput && ourNode.op != _INPUT)
+		{
+			ourNode.result.reset();
+			std :: lock_guard<std :: mutex> lock(_run->mutex);
+			_run->liveBytes -= _bytes(node);
+		}
+		for(size_t i = 0; i < ourNode.consumers.size(); ++i)
+		{
+			if(--_nodes[ourNode.consumers[i]].pending == 0)
+			{
+				_schedule(ourNode.consumers[i]);
+			}
+		}
+		std :: lock_guard<std :: mutex> lock(_run->mutex);
+		if(--_run->left == 0)
+		{
+			_run->finished.notify_all();
+		}
+	}
+
+	std :: vector<_Node> _nodes; /**< The nodes, each after its operands. */
+	MatrixGraphStats _stats; /**< Statistics of the last run. */
+	_Run *_run; /**< Bookkeeping of the run in progress, null between runs. */
+	std :: chrono :: steady_clock :: time_point _start; /**< When the run in progress started. */
+};
+
+#endif
@@ -0,0 +1,487 @@
+/********************************************************************************
+ * @file MatrixMemory.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix memory accounting header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix memory accounting header.
+ *
+ * Opt in accounting of the memory held by matrices. When the program is compiled with
+ * -DMATRIX_MEMORY every buffer of cells allocated by MatrixAllocator is counted, both in total
+ * and per element type: the bytes live, the most bytes ever live at once (the high water mark),
+ * and the number of allocations and frees. MatrixMemoryScope reports the same for the part of
+ * the program it spans, and writeReport prints a table per element type.
+ *
+ * A limit on the live bytes can be set with setLimit or the MATRIX_MEMORY_LIMIT environment
+ * variable. An allocation that would go past it fails with std :: bad_alloc before any memory
+ * is asked of the system, so a program over its budget fails with a bad_alloc it can catch
+ * rather than being killed by the system.
+ *
+ * Without MATRIX_MEMORY the MATRIX_MEMORY_* macros compile to no code.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws std :: bad_alloc for an allocation past the limit.
+ ********************************************************************************/
+
+#ifndef MATRIX_MEMORY_H
+#define MATRIX_MEMORY_H
+
+#ifdef MATRIX_MEMORY
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <cxxabi.h>
+
+/*
+ * @def MEMORY_LIMIT_ENV
+ * @brief environment variable holding the limit in bytes on the live bytes of all matrices
+ */
+#define MEMORY_LIMIT_ENV "MATRIX_MEMORY_LIMIT"
+
+/**
+ * @brief The memory of matrices at one moment
+ */
+struct MatrixMemoryUsage
+{
+	size_t live; /**< Bytes allocated and not yet freed. */
+	size_t peak; /**< Most bytes live at once. */
+	size_t allocations; /**< Buffers allocated. */
+	size_t frees; /**< Buffers freed. */
+};
+
+/**
+ * @brief Counters of the memory of a set of buffers, updated by any thread
+ */
+class MatrixMemoryCounters
+{
+public:
+
+	MatrixMemoryCounters() : _live(0), _peak(0), _allocations(0), _frees(0)
+	{
+	}
+
+	/**
+	 * @brief Counts an allocation
+	 * @param bytes allocated
+	 * @return the bytes live with it
+	 */
+	size_t allocate(size_t bytes)
+	{
+		++_allocations;
+		const size_t live = _live += bytes;
+		raisePeak(live);
+		return live;
+	}
+
+	/**
+	 * @brief Counts an allocation if it keeps the live bytes within a limit
+	 * @param bytes to allocate
+	 * @param most bytes live, 0 for no limit
+	 * @return true if counted, false if it would go past the limit
+	 */
+	bool allocateWithin(size_t bytes, size_t limit)
+	{
+		size_t live = _live;
+		do
+		{
+			if(limit != 0 && (bytes > limit || live > limit - bytes))
+			{
+				return false;
+			}
+		}
+		while(!_live.compare_exchange_weak(live, live + bytes));
+		++_allocations;
+		raisePeak(live + bytes);
+		return true;
+	}
+
+	/**
+	 * @brief Counts a free, or an allocation that failed and is taken back
+	 * @param bytes freed
+	 * @param false for an allocation taken back, which counts as neither an allocation nor a free
+	 */
+	void free(size_t bytes, bool freed = true)
+	{
+		_live -= bytes;
+		if(freed)
+		{
+			++_frees;
+		}
+		else
+		{
+			--_allocations;
+		}
+	}
+
+	/**
+	 * @brief Raises the high water mark to a number of live bytes if it is higher
+	 * @param the live bytes
+	 */
+	void raisePeak(size_t live)
+	{
+		size_t peak = _peak;
+		while(live > peak && !_peak.compare_exchange_weak(peak, live))
+		{
+		}
+	}
+
+	/**
+	 * @brief Getter for the counts
+	 * @return the counts at this moment
+	 */
+	MatrixMemoryUsage usage() const
+	{
+		MatrixMemoryUsage counts = {_live, _peak, _allocations, _frees};
+		return counts;
+	}
+
+	/**
+	 * @brief Lowers the high water mark to the bytes live now
+	 */
+	void resetPeak()
+	{
+		_peak = _live.load();
+	}
+
+private:
+
+	std :: atomic<size_t> _live; /**< Bytes allocated and not yet freed. */
+	std :: atomic<size_t> _peak; /**< Most bytes live at once. */
+	std :: atomic<size_t> _allocations; /**< Buffers allocated. */
+	std :: atomic<size_t> _frees; /**< Buffers freed. */
+};
+
+class MatrixMemoryScope;
+
+/**
+ * @brief The accountant of the memory of all matrices of the program
+ */
+class MatrixMemory
+{
+	friend class MatrixMemoryScope;
+
+public:
+
+	/**
+	 * @brief Getter for the accountant, with the limit of MATRIX_MEMORY_LIMIT if it is set
+	 * @return the accountant
+	 */
+	static MatrixMemory& instance()
+	{
+		static MatrixMemory memory;
+		return memory;
+	}
+
+	/**
+	 * @brief Getter for the counters of the buffers of cells of type T
+	 * @return the counters
+	 */
+	template <typename T>
+	static MatrixMemoryCounters& counters()
+	{
+		static MatrixMemoryCounters& typed = instance()._type(_demangle(typeid(T).name()));
+		return typed;
+	}
+
+	/**
+	 * @brief Counts an allocation of a buffer of cells of type T
+	 * @param bytes to allocate
+	 */
+	template <typename T>
+	void allocate(size_t bytes)
+	{
+		if(!_total.allocateWithin(bytes, _limit))
+		{
+			throw std :: bad_alloc();
+		}
+		counters<T>().allocate(bytes);
+		if(_scopeAmnt > 0)
+		{
+			_raiseScopes(_total.usage().live);
+		}
+	}
+
+	/**
+	 * @brief Counts a free of a buffer of cells of type T
+	 * @param bytes freed
+	 * @param false for an allocation the system failed, which is taken back
+	 */
+	template <typename T>
+	void free(size_t bytes, bool freed = true)
+	{
+		_total.free(bytes, freed);
+		counters<T>().free(bytes, freed);
+	}
+
+	/**
+	 * @brief Getter for the memory of all matrices
+	 * @return the counts at this moment
+	 */
+	MatrixMemoryUsage usage() const
+	{
+		return _total.usage();
+	}
+
+	/**
+	 * @brief Getter for the memory of the matrices of cells of type T
+	 * @return the counts at this moment
+	 */
+	template <typename T>
+	MatrixMemoryUsage usage() const
+	{
+		return counters<T>().usage();
+	}
+
+	/**
+	 * @brief Sets the most bytes all matrices may hold at once
+	 * @param the limit in bytes, 0 for none
+	 */
+	void setLimit(size_t bytes)
+	{
+		_limit = bytes;
+	}
+
+	/**
+	 * @brief Getter for the limit on the live bytes
+	 * @return the limit in bytes, 0 for none
+	 */
+	size_t limit() const
+	{
+		return _limit;
+	}
+
+	/**
+	 * @brief Lowers the high water marks of all matrices and of every element type to the bytes
+	 * live now
+	 */
+	void resetPeak()
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		_total.resetPeak();
+		for(_TypeMap :: iterator it = _types.begin(); it != _types.end(); ++it)
+		{
+			it->second->resetPeak();
+		}
+	}
+
+	/**
+	 * @brief Prints the memory of every element type and of all matrices
+	 * @param the stream to print to
+	 */
+	void writeReport(std :: ostream& os) const
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		os << std :: left << std :: setw(24) << "type" << std :: right << std :: setw(16) << "live"
+		   << std :: setw(16) << "peak" << std :: setw(14) << "allocations" << std :: setw(14)
+		   << "frees" << std :: endl;
+		for(_TypeMap :: const_iterator it = _types.begin(); it != _types.end(); ++it)
+		{
+			_writeRow(os, it->first, it->second->usage());
+		}
+		_writeRow(os, "all", _total.usage());
+		if(_limit != 0)
+		{
+			os << "limit " << _limit << " bytes" << std :: endl;
+		}
+	}
+
+private:
+
+	typedef std :: map<std :: string, std :: unique_ptr<MatrixMemoryCounters>> _TypeMap;
+
+	/**
+	 * @brief Constructor reading the limit from the environment
+	 */
+	MatrixMemory() : _limit(0), _scopeAmnt(0)
+	{
+		const char *limit = std :: getenv(MEMORY_LIMIT_ENV);
+		if(limit != nullptr)
+		{
+			_limit = std :: strtoull(limit, nullptr, 10);
+		}
+	}
+
+	/**
+	 * @brief Getter for the counters of an element type, created on first use
+	 * @param name of the type
+	 * @return the counters
+	 */
+	MatrixMemoryCounters& _type(const std :: string& name)
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		std :: unique_ptr<MatrixMemoryCounters>& typed = _types[name];
+		if(!typed)
+		{
+			typed.reset(new MatrixMemoryCounters());
+		}
+		return *typed;
+	}
+
+	/**
+	 * @brief Readable name of a type
+	 * @param name of the type from std :: type_info
+	 * @return the demangled name, the name itself if it cannot be demangled
+	 */
+	static std :: string _demangle(const char *mangled)
+	{
+		int status = 0;
+		char *name = abi :: __cxa_demangle(mangled, nullptr, nullptr, &status);
+		std :: string readable = status == 0 && name != nullptr ? name : mangled;
+		std :: free(name);
+		return readable;
+	}
+
+	/**
+	 * @brief Prints a row of the report
+	 * @param the stream to print to
+	 * @param name of the row
+	 * @param the counts
+	 */
+	static void _writeRow(std :: ostream& os, const std :: string& name,
+						  const MatrixMemoryUsage& usage)
+	{
+		os << std :: left << std :: setw(24) << name << std :: right << std :: setw(16)
+		   << usage.live << std :: setw(16) << usage.peak << std :: setw(14) << usage.allocations
+		   << std :: setw(14) << usage.frees << std :: endl;
+	}
+
+	/**
+	 * @brief Raises the high water marks of the scopes that exist
+	 * @param the live bytes of all matrices
+	 */
+	void _raiseScopes(size_t live);
+
+	MatrixMemoryCounters _total; /**< Counters of all matrices. */
+	std :: atomic<size_t> _limit; /**< Most live bytes, 0 for none. */
+	std :: atomic<size_t> _scopeAmnt; /**< Number of scopes that exist. */
+	mutable std :: mutex _mutex; /**< Guards _types and _scopes. */
+	_TypeMap _types; /**< Counters of every element type. */
+	std :: set<MatrixMemoryScope *> _scopes; /**< The scopes that exist. */
+};
+
+/**
+ * @brief Reports the memory of matrices allocated and freed while it exists, and the most bytes
+ * of all matrices live at once meanwhile
+ */
+class MatrixMemoryScope
+{
+public:
+
+	/**
+	 * @brief Constructor starting the report from the counts of this moment
+	 */
+	MatrixMemoryScope() : _start(MatrixMemory :: instance().usage())
+	{
+		_counts.raisePeak(_start.live);
+		MatrixMemory& memory = MatrixMemory :: instance();
+		std :: lock_guard<std :: mutex> lock(memory._mutex);
+		memory._scopes.insert(this);
+		++memory._scopeAmnt;
+	}
+
+	/**
+	 * @brief Destructor ending the report
+	 */
+	~MatrixMemoryScope()
+	{
+		MatrixMemory& memory = MatrixMemory :: instance();
+		std :: lock_guard<std :: mutex> lock(memory._mutex);
+		memory._scopes.erase(this);
+		--memory._scopeAmnt;
+	}
+
+	MatrixMemoryScope(const MatrixMemoryScope&) = delete;
+	MatrixMemoryScope& operator=(const MatrixMemoryScope&) = delete;
+
+	/**
+	 * @brief Getter for the memory of the scope so far
+	 * @return the live bytes of all matrices now, the most live at once since the scope started,
+	 * and the allocations and frees since it started
+	 */
+	MatrixMemoryUsage usage() const
+	{
+		MatrixMemoryUsage now = MatrixMemory :: instance().usage();
+		MatrixMemoryUsage counts = {now.live, _counts.usage().peak,
+									now.allocations - _start.allocations, now.frees - _start.frees};
+		return counts;
+	}
+
+	/**
+	 * @brief Getter for the bytes that were live when the scope started
+	 * @return the live bytes
+	 */
+	size_t startLive() const
+	{
+		return _start.live;
+	}
+
+	/**
+	 * @brief Raises the high water mark of the scope
+	 * @param the live bytes of all matrices
+	 */
+	void raisePeak(size_t live)
+	{
+		_counts.raisePeak(live);
+	}
+
+private:
+
+	MatrixMemoryUsage _start; /**< The counts when the scope started. */
+	MatrixMemoryCounters _counts; /**< Holds the high water mark of the scope. */
+};
+
+/**
+ * @see MatrixMemory :: _raiseScopes
+ */
+inline void MatrixMemory :: _raiseScopes(size_t live)
+{
+	std :: lock_guard<std :: mutex> lock(_mutex);
+	for(std :: set<MatrixMemoryScope *> :: iterator it = _scopes.begin(); it != _scopes.end(); ++it)
+	{
+		(*it)->raisePeak(live);
+	}
+}
+
+/*
+ * @def MATRIX_MEMORY_ALLOC
+ * @brief counts an allocation of a buffer of cells, throws std :: bad_alloc past the limit
+ */
+#define MATRIX_MEMORY_ALLOC(T, bytes) MatrixMemory :: instance().allocate<T>(bytes)
+
+/*
+ * @def MATRIX_MEMORY_FAILED
+ * @brief takes back an allocation the system failed
+ */
+#define MATRIX_MEMORY_FAILED(T, bytes) MatrixMemory :: instance().free<T>(bytes, false)
+
+/*
+ * @def MATRIX_MEMORY_FREE
+ * @brief counts a free of a buffer of cells
+ */
+#define MATRIX_MEMORY_FREE(T, bytes) MatrixMemory :: instance().free<T>(bytes)
+
+#else
+
+#define MATRIX_MEMORY_ALLOC(T, bytes) ((void)(bytes))
+#define MATRIX_MEMORY_FAILED(T, bytes) ((void)(bytes))
+#define MATRIX_MEMORY_FREE(T, bytes) ((void)(bytes))
+
+#endif
+
+#endif
@@ -0,0 +1,401 @@
+/********************************************************************************
+ * @file MatrixOutOfCore.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard out of core Matrix multiplication header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard out of core Matrix multiplication.
+ *
+ * Multiplies two matrix files into a third one without ever holding a whole matrix in memory.
+ * The product is computed tile by tile: while the current A and B tiles are multiplied the next
+ * pair is read from disk in the background, and every finished C tile is written back in the
+ * background as well. All buffers together stay under a memory budget given by the caller.
+ * The rows of every tile product are split on the shared pool, and the cancellation token of
+ * the caller is checked before every tile.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws BadDimensionException when the dimensions of the files don't match,
+ * std :: invalid_argument when the product would overwrite one of its operands, and
+ * std :: runtime_error when a file cannot be read or written.
+ ********************************************************************************/
+
+#ifndef MATRIX_OUT_OF_CORE_H
+#define MATRIX_OUT_OF_CORE_H
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <string>
+#include <vector>
+#include "BadDimensionException.h"
+#include "MatrixCancel.h"
+#include "MatrixFile.h"
+#include "ThreadPool.h"
+
+/*
+ * @def TILE_BUFFERS
+ * @brief number of tiles held at once: a current and a prefetched tile of A, B and C
+ */
+#define TILE_BUFFERS 6
+
+/*
+ * @def BUDGET_MESSAGE
+ * @brief print message for a memory budget too small to hold a single tile
+ */
+#define BUDGET_MESSAGE "Memory budget too small for out of core multiplication."
+
+/*
+ * @def OUT_OF_CORE_MESSAGE
+ * @brief print message for matrix files of dimensions that cannot be multiplied
+ */
+#define OUT_OF_CORE_MESSAGE "Wrong dimensions for out of core multiplication."
+
+/*
+ * @def IO_FILE_MESSAGE
+ * @brief print message for a failed read or write of a matrix file
+ */
+#define IO_FILE_MESSAGE "Cannot access matrix file: "
+
+/*
+ * @def SAME_FILE_MESSAGE
+ * @brief print message for a product file that is also one of the operands
+ */
+#define SAME_FILE_MESSAGE "Out of core product would overwrite its operand: "
+
+/**
+ * @brief A matrix file opened for reading or writing tiles of cells at arbitrary positions.
+ */
+template <typename T>
+class MatrixTileFile
+{
+public:
+
+	/**
+	 * @brief Opens an existing matrix file for reading tiles
+	 * @param path of the file
+	 */
+	explicit MatrixTileFile(const std :: string& path) : _path(path)
+	{
+		_fd = ::open(path.c_str(), O_RDONLY);
+		if(_fd < 0)
+		{
+			throw std :: runtime_error(OPEN_FILE_MESSAGE + path);
+		}
+		struct stat info;
+		if(::pread(_fd, &_header, sizeof(_header), 0) != (ssize_t)sizeof(_header) ||
+		   !_header.isValid() || ::fstat(_fd, &info) != 0 || !_header.fits(info.st_size))
+		{
+			::close(_fd);
+			throw std :: runtime_error(BAD_FILE_MESSAGE + path);
+		}
+		if(_header.elemSize != sizeof(T) || _header.dtype != MatrixDataTypeOf<T> :: value)
+		{
+			::close(_fd);
+			throw std :: runtime_error(DTYPE_FILE_MESSAGE + path);
+		}
+	}
+
+	/**
+	 * @brief Creates a new matrix file of the given dimensions for writing tiles
+	 * @param path of the file
+	 * @param row dimension
+	 * @param column dimension
+	 */
+	MatrixTileFile(const std :: string& path, uint64_t rowAmnt, uint64_t colAmnt) : _path(path)
+	{
+		_header = MatrixFileHeader :: describe<T>(rowAmnt, colAmnt);
+		_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(_fd < 0)
+		{
+			throw std :: runtime_error(OPEN_FILE_MESSAGE + path);
+		}
+		// write the header and size the file so tiles can be written in any order
+		if(::pwrite(_fd, &_header, sizeof(_header), 0) != (ssize_t)sizeof(_header) ||
+		   ::ftruncate(_fd, _header.dataOffset + _header.dataSize()) != 0)
+		{
+			::close(_fd);
+			throw std :: runtime_error(IO_FILE_MESSAGE + path);
+		}
+	}
+
+	/**
+	 * @brief Closes the file
+	 */
+	~MatrixTileFile()
+	{
+		::close(_fd);
+	}
+
+	MatrixTileFile(const MatrixTileFile&) = delete;
+	MatrixTileFile& operator=(const MatrixTileFile&) = delete;
+
+	/**
+	 * @brief Getter for the row dimension of the file
+	 * @return row dimension
+	 */
+	uint64_t rows() const
+	{
+		return _header.rows;
+	}
+
+	/**
+	 * @brief Getter for the column dimension of the file
+	 * @return column dimension
+	 */
+	uint64_t cols() const
+	{
+		return _header.cols;
+	}
+
+	/**
+	 * @brief Checks whether a path names this same file, through any link to it
+	 * @param path to check
+	 * @return true if the path is this file, false otherwise or if there is no such file
+	 */
+	bool isFile(const std :: string& path) const
+	{
+		struct stat ours, theirs;
+		return ::fstat(_fd, &ours) == 0 && ::stat(path.c_str(), &theirs) == 0 &&
+			   ours.st_dev == theirs.st_dev && ours.st_ino == theirs.st_ino;
+	}
+
+	/**
+	 * @brief Reads a tile of cells into a buffer, row after row
+	 * @param buffer of at least tileRows * tileCols cells
+	 * @param first row of the tile (0 based)
+	 * @param first column of the tile (0 based)
+	 * @param row dimension of the tile
+	 * @param column dimension of the tile
+	 */
+	void readTile(T *buffer, uint64_t row, uint64_t col, uint64_t tileRows, uint64_t tileCols) const
+	{
+		_transfer(buffer, row, col, tileRows, tileCols, false);
+	}
+
+	/**
+	 * @brief Writes a tile of cells from a buffer, row after row
+	 * @param buffer of at least tileRows * tileCols cells
+	 * @param first row of the tile (0 based)
+	 * @param first column of the tile (0 based)
+	 * @param row dimension of the tile
+	 * @param column dimension of the tile
+	 */
+	void writeTile(const T *buffer, uint64_t row, uint64_t col, uint64_t tileRows,
+				   uint64_t tileCols)
+	{
+		_transfer(const_cast<T *>(buffer), row, col, tileRows, tileCols, true);
+	}
+
+private:
+
+	/**
+	 * @brief Moves a tile between the file and a buffer. A tile that spans whole rows is a
+	 * single contiguous range of the file and is moved in one call.
+	 */
+	void _transfer(T *buffer, uint64_t row, uint64_t col, uint64_t tileRows, uint64_t tileCols,
+				   bool write) const
+	{
+		bool wholeRows = (col == 0 && tileCols == cols());
+		uint64_t segments = wholeRows ? 1 : tileRows;
+		size_t segmentBytes = (wholeRows ? tileRows * tileCols : tileCols) * sizeof(T);
+		for(uint64_t i = 0; i < segments; ++i)
+		{
+			char *cursor = reinterpret_cast<char *>(buffer + i * tileCols);
+			off_t offset = _header.dataOffset + ((row + i) * cols() + col) * sizeof(T);
+			size_t left = segmentBytes;
+			// pread and pwrite may move less than asked for, loop until the segment is done
+			while(left > 0)
+			{
+				ssize_t moved = write ? ::pwrite(_fd, cursor, left, offset) :
+										::pread(_fd, cursor, left, offset);
+				if(moved <= 0)
+				{
+					throw std :: runtime_error(IO_FILE_MESSAGE + _path);
+				}
+				cursor += moved;
+				offset += moved;
+				left -= moved;
+			}
+		}
+	}
+
+	std :: string _path; /**< Path of the file, for error messages. */
+	int _fd; /**< Descriptor of the open file. */
+	MatrixFileHeader _header; /**< Header of the file. */
+};
+
+/**
+ * @brief Adds the product of an A tile and a B tile to some rows of a C tile. Loops in i-k-j
+ * order so the inner loop walks B and C contiguously.
+ * @param C tile, tileRows x tileCols
+ * @param A tile, tileRows x depth
+ * @param B tile, depth x tileCols
+ * @param first row of C to update
+ * @param one past the last row of C to update
+ * @param column dimension of the C and B tiles
+ * @param column dimension of the A tile
+ */
+template <typename T>
+void multiplyTileRows(T *cTile, const T *aTile, const T *bTile, uint64_t firstRow,
+					  uint64_t lastRow, uint64_t tileCols, uint64_t depth)
+{
+	for(uint64_t i = firstRow; i < lastRow; ++i)
+	{
+		T *cRow = cTile + i * tileCols;
+		for(uint64_t k = 0; k < depth; ++k)
+		{
+			const T a = aTile[i * depth + k];
+			const T *bRow = bTile + k * tileCols;
+			for(uint64_t j = 0; j < tileCols; ++j)
+			{
+				cRow[j] += a * bRow[j];
+			}
+		}
+	}
+}
+
+/**
+ * @brief Multiplies the matrix file at aPath by the matrix file at bPath and writes the product
+ * to a new matrix file at cPath.
+ * @param path of the left operand
+ * @param path of the right operand
+ * @param path of the product to create
+ * @param number of bytes all tile buffers together may use
+ * @param whether to split every tile product over threads
+ */
+template <typename T>
+void multiplyOutOfCore(const std :: string& aPath, const std :: string& bPath,
+					   const std :: string& cPath, size_t memoryBudget, bool parallel)
+{
+	MatrixTileFile<T> a(aPath);
+	MatrixTileFile<T> b(bPath);
+	if(a.cols() != b.rows())
+	{
+		throw BadDimensionException(OUT_OF_CORE_MESSAGE);
+	}
+	// creating the product truncates its file, which must not be read from
+	if(a.isFile(cPath) || b.isFile(cPath))
+	{
+		throw std :: invalid_argument(SAME_FILE_MESSAGE + cPath);
+	}
+	MatrixTileFile<T> c(cPath, a.rows(), b.cols());
+	if(a.rows() == 0 || b.cols() == 0 || a.cols() == 0)
+	{
+		return;
+	}
+
+	// pick the largest square tile so that all the double buffered tiles fit in the budget
+	uint64_t tile = (uint64_t)std :: sqrt((double)memoryBudget / (TILE_BUFFERS * sizeof(T)));
+	if(tile == 0)
+	{
+		throw std :: invalid_argument(BUDGET_MESSAGE);
+	}
+	const uint64_t tileM = std :: min<uint64_t>(tile, a.rows());
+	const uint64_t tileK = std :: min<uint64_t>(tile, a.cols());
+	const uint64_t tileN = std :: min<uint64_t>(tile, b.cols());
+	const uint64_t blocksM = (a.rows() + tileM - 1) / tileM;
+	const uint64_t blocksK = (a.cols() + tileK - 1) / tileK;
+	const uint64_t blocksN = (b.cols() + tileN - 1) / tileN;
+	const uint64_t steps = blocksM * blocksN * blocksK;
+
+	std :: vector<T> aTiles[2], bTiles[2], cTiles[2];
+	for(int i = 0; i < 2; ++i)
+	{
+		aTiles[i].resize(tileM * tileK);
+		bTiles[i].resize(tileK * tileN);
+		cTiles[i].resize(tileM * tileN);
+	}
+
+	// the tiles of step s are A(ib, kb) and B(kb, jb), with kb running fastest so that every
+	// C tile is finished after blocksK consecutive steps
+	auto fetch = [&](uint64_t step, int slot)
+	{
+		uint64_t kb = step % blocksK;
+		uint64_t jb = (step / blocksK) % blocksN;
+		uint64_t ib = step / (blocksK * blocksN);
+		uint64_t m = std :: min(tileM, a.rows() - ib * tileM);
+		uint64_t k = std :: min(tileK, a.cols() - kb * tileK);
+		uint64_t n = std :: min(tileN, b.cols() - jb * tileN);
+		a.readTile(aTiles[slot].data(), ib * tileM, kb * tileK, m, k);
+		b.readTile(bTiles[slot].data(), kb * tileK, jb * tileN, k, n);
+	};
+
+	ThreadPool& pool = ThreadPool :: shared();
+	MatrixCancellation *token = MatrixCancellation :: current().get();
+	if(token != nullptr)
+	{
+		token->addWork(a.rows() * a.cols() * b.cols());
+	}
+	std :: future<void> prefetch = std :: async(std :: launch :: async, fetch, 0, 0);
+	std :: future<void> writeBack[2];
+	for(uint64_t step = 0; step < steps; ++step)
+	{
+		int slot = step % 2;
+		prefetch.get();
+		// start reading the next pair of tiles while we multiply the current one
+		if(step + 1 < steps)
+		{
+			prefetch = std :: async(std :: launch :: async, fetch, step + 1, 1 - slot);
+		}
+
+		uint64_t kb = step % blocksK;
+		uint64_t jb = (step / blocksK) % blocksN;
+		uint64_t ib = step / (blocksK * blocksN);
+		uint64_t m = std :: min(tileM, a.rows() - ib * tileM);
+		uint64_t k = std :: min(tileK, a.cols() - kb * tileK);
+		uint64_t n = std :: min(tileN, b.cols() - jb * tileN);
+		if(token != nullptr)
+		{
+			token->check();
+		}
+		int cSlot = (step / blocksK) % 2;
+		std :: vector<T>& cTile = cTiles[cSlot];
+		if(kb == 0)
+		{
+			// this C buffer may still be on its way to disk from two tiles ago
+			if(writeBack[cSlot].valid())
+			{
+				writeBack[cSlot].get();
+			}
+			std :: fill(cTile.begin(), cTile.begin() + m * n, T());
+		}
+
+		// split the rows of the C tile between the workers, or run them all here when serial
+		const T *aTile = aTiles[slot].data();
+		const T *bTile = bTiles[slot].data();
+		pool.parallelFor(0, m, (m + pool.size() - 1) / pool.size(), [&](size_t first, size_t last)
+		{
+			multiplyTileRows<T>(cTile.data(), aTile, bTile, first, last, n, k);
+		}, parallel ? 0 : 1);
+		if(token != nullptr)
+		{
+			token->addDone(m * k * n);
+		}
+
+		// the C tile is complete, stream it back to disk in the background
+		if(kb == blocksK - 1)
+		{
+			writeBack[cSlot] = std :: async(std :: launch :: async, [&c, &cTile, ib, jb, m, n,
+																	  tileM, tileN]()
+			{
+				c.writeTile(cTile.data(), ib * tileM, jb * tileN, m, n);
+			});
+		}
+	}
+	for(int i = 0; i < 2; ++i)
+	{
+		if(writeBack[i].valid())
+		{
+			writeBack[i].get();
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,420 @@
+/********************************************************************************
+ * @file MatrixPerf.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix hardware counters header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix hardware counters header.
+ *
+ * Opt in profiling of the Matrix kernels with the Linux perf_event_open hardware counters. When
+ * the program is compiled with -DMATRIX_PERF every kernel reads the cycles, instructions, cache
+ * misses, L1 data read misses and branch misses of the threads running it, and the counts are
+ * added up per operation and size class (the number of cells rounded up to a power of two).
+ *
+ * There is no generic perf event for vector instructions, so a raw event of the machine can be
+ * counted as well by setting MATRIX_PERF_RAW to its code, e.g. MATRIX_PERF_RAW=0x1004c7 counts
+ * FP_ARITH_INST_RETIRED.256B_PACKED_DOUBLE on recent Intel cores.
+ *
+ * Without MATRIX_PERF the MATRIX_PERF_* macros compile to no code.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Counters that cannot be opened (no PMU, perf_event_paranoid too high) read as zero and the
+ * report says they were unavailable. Profiling never throws out of an operation, counts that
+ * cannot be stored are dropped and counted.
+ ********************************************************************************/
+
+#ifndef MATRIX_PERF_H
+#define MATRIX_PERF_H
+
+#ifdef MATRIX_PERF
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * @def PERF_RAW_ENV
+ * @brief environment variable holding the code of an extra raw event to count
+ */
+#define PERF_RAW_ENV "MATRIX_PERF_RAW"
+
+/**
+ * @brief The counters read around a kernel
+ */
+enum MatrixPerfCounter
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_L1D_READ_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_RAW,
+	PERF_COUNTERS
+};
+
+/**
+ * @brief Counts added up for one operation and size class
+ */
+struct MatrixPerfTotals
+{
+	MatrixPerfTotals() : calls(0)
+	{
+		std :: memset(counts, 0, sizeof(counts));
+	}
+
+	unsigned long long calls; /**< Number of times the operation ran. */
+	unsigned long long counts[PERF_COUNTERS]; /**< Sum of each counter over all its kernels. */
+};
+
+/**
+ * @brief The hardware counters of the calling thread, opened on first use and closed when the
+ * thread exits
+ */
+class MatrixThreadCounters
+{
+public:
+
+	/**
+	 * @brief Getter for the counters of the calling thread
+	 * @return the counters
+	 */
+	static MatrixThreadCounters& current()
+	{
+		thread_local MatrixThreadCounters counters;
+		return counters;
+	}
+
+	/**
+	 * @brief Reads every counter, scaled for the time it was multiplexed out
+	 * @param array of PERF_COUNTERS values to fill
+	 */
+	void read(unsigned long long *values) const
+	{
+		for(int i = 0; i < PERF_COUNTERS; ++i)
+		{
+			uint64_t raw[3] = {0, 0, 0};
+			values[i] = 0;
+			if(_fds[i] >= 0 && ::read(_fds[i], raw, sizeof(raw)) == (ssize_t)sizeof(raw) &&
+			   raw[2] > 0)
+			{
+				// a counter that was multiplexed out part of the time is scaled to the whole time
+				values[i] = raw[2] < raw[1] ?
+							(unsigned long long)((double)raw[0] * raw[1] / raw[2]) : raw[0];
+			}
+		}
+	}
+
+	/**
+	 * @brief Checks whether a counter could be opened on this thread
+	 * @param the counter
+	 * @return true if it counts, false otherwise
+	 */
+	bool available(int counter) const
+	{
+		return _fds[counter] >= 0;
+	}
+
+	~MatrixThreadCounters()
+	{
+		for(int i = 0; i < PERF_COUNTERS; ++i)
+		{
+			if(_fds[i] >= 0)
+			{
+				::close(_fds[i]);
+			}
+		}
+	}
+
+	MatrixThreadCounters(const MatrixThreadCounters&) = delete;
+	MatrixThreadCounters& operator=(const MatrixThreadCounters&) = delete;
+
+private:
+
+	MatrixThreadCounters()
+	{
+		_fds[PERF_CYCLES] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		_fds[PERF_INSTRUCTIONS] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		_fds[PERF_CACHE_MISSES] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+		_fds[PERF_L1D_READ_MISSES] = _open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+										   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+										   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+		_fds[PERF_BRANCH_MISSES] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		const char *raw = std :: getenv(PERF_RAW_ENV);
+		_fds[PERF_RAW] = raw != nullptr ? _open(PERF_TYPE_RAW, std :: strtoull(raw, nullptr, 0))
+										: -1;
+	}
+
+	/**
+	 * @brief Opens a counter of user space work of the calling thread on any cpu
+	 * @return its descriptor, or -1 if it cannot be counted here
+	 */
+	static int _open(uint32_t type, uint64_t config)
+	{
+		struct perf_event_attr attr;
+		std :: memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return (int)::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	int _fds[PERF_COUNTERS]; /**< Descriptor of each counter, -1 if unavailable. */
+};
+
+/**
+ * @brief Adds up the counts of all the kernels of the program
+ */
+class MatrixPerf
+{
+public:
+
+	typedef std :: pair<std :: string, unsigned long long> Key; /**< Operation and size class. */
+
+	/**
+	 * @brief Getter for the profile of the program
+	 * @return the profile
+	 */
+	static MatrixPerf& instance()
+	{
+		static MatrixPerf perf;
+		return perf;
+	}
+
+	/**
+	 * @brief Size class of an operation, its number of cells rounded up to a power of two
+	 * @param number of cells
+	 * @return the size class
+	 */
+	static unsigned long long sizeClass(unsigned long long cells)
+	{
+		unsigned long long size = 1;
+		while(size < cells)
+		{
+			size <<= 1;
+		}
+		return size;
+	}
+
+	/**
+	 * @brief Adds counts and calls to an operation. Called from destructors, so counts that
+	 * cannot be stored are dropped instead of throwing.
+	 * @param name of the operation
+	 * @param number of cells of the operation
+	 * @param counts to add, or nullptr to only add calls
+	 * @param number of calls to add
+	 */
+	void add(const char *op, unsigned long long cells, const unsigned long long *counts,
+			 unsigned long long calls) noexcept
+	{
+		try
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			MatrixPerfTotals& totals = _totals[Key(op, sizeClass(cells))];
+			totals.calls += calls;
+			for(int i = 0; counts != nullptr && i < PERF_COUNTERS; ++i)
+			{
+				totals.counts[i] += counts[i];
+			}
+		}
+		catch (...)
+		{
+			++_dropped;
+		}
+	}
+
+	/**
+	 * @brief Getter for the number of additions dropped because they could not be stored
+	 * @return the dropped additions
+	 */
+	unsigned long long dropped() const
+	{
+		return _dropped;
+	}
+
+	/**
+	 * @brief Getter for a copy of the totals so far
+	 * @return the totals by operation and size class
+	 */
+	std :: map<Key, MatrixPerfTotals> totals() const
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		return _totals;
+	}
+
+	/**
+	 * @brief Drops the totals so far
+	 */
+	void clear()
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		_totals.clear();
+		_dropped = 0;
+	}
+
+	/**
+	 * @brief Writes a table of the totals with the IPC and miss rates they amount to
+	 * @param stream to write to
+	 */
+	void writeReport(std :: ostream& os) const
+	{
+		std :: map<Key, MatrixPerfTotals> recorded = totals();
+		const MatrixThreadCounters& counters = MatrixThreadCounters :: current();
+		if(!counters.available(PERF_CYCLES))
+		{
+			os << "hardware counters unavailable (check perf_event_paranoid)" << std :: endl;
+		}
+		if(_dropped > 0)
+		{
+			os << _dropped << " additions dropped for lack of memory" << std :: endl;
+		}
+		os << std :: left << std :: setw(14) << "op" << std :: right << std :: setw(12)
+		   << "cells<=" << std :: setw(8) << "calls" << std :: setw(16) << "cycles"
+		   << std :: setw(8) << "IPC" << std :: setw(14) << "cache-miss" << std :: setw(14)
+		   << "L1d-miss" << std :: setw(14) << "branch-miss" << std :: setw(14) << "raw"
+		   << std :: endl;
+		for(std :: map<Key, MatrixPerfTotals> :: const_iterator it = recorded.begin();
+			it != recorded.end(); ++it)
+		{
+			const unsigned long long *c = it->second.counts;
+			os << std :: left << std :: setw(14) << it->first.first << std :: right
+			   << std :: setw(12) << it->first.second << std :: setw(8) << it->second.calls
+			   << std :: setw(16) << c[PERF_CYCLES] << std :: setw(8) << std :: setprecision(3)
+			   << _ratio(c[PERF_INSTRUCTIONS], c[PERF_CYCLES]) << std :: setw(14)
+			   << c[PERF_CACHE_MISSES] << std :: setw(14) << c[PERF_L1D_READ_MISSES]
+			   << std :: setw(14) << c[PERF_BRANCH_MISSES] << std :: setw(14) << c[PERF_RAW]
+			   << std :: endl;
+		}
+	}
+
+	/**
+	 * @brief Writes the totals as a JSON array
+	 * @param stream to write to
+	 */
+	void writeJson(std :: ostream& os) const
+	{
+		std :: map<Key, MatrixPerfTotals> recorded = totals();
+		os << "[";
+		for(std :: map<Key, MatrixPerfTotals> :: const_iterator it = recorded.begin();
+			it != recorded.end(); ++it)
+		{
+			const unsigned long long *c = it->second.counts;
+			os << (it == recorded.begin() ? "\n" : ",\n") << "    {\"op\": \"" << it->first.first
+			   << "\", \"size_class\": " << it->first.second << ", \"calls\": "
+			   << it->second.calls << ", \"cycles\": " << c[PERF_CYCLES]
+			   << ", \"instructions\": " << c[PERF_INSTRUCTIONS] << ", \"ipc\": "
+			   << _ratio(c[PERF_INSTRUCTIONS], c[PERF_CYCLES]) << ", \"cache_misses\": "
+			   << c[PERF_CACHE_MISSES] << ", \"l1d_read_misses\": " << c[PERF_L1D_READ_MISSES]
+			   << ", \"branch_misses\": " << c[PERF_BRANCH_MISSES] << ", \"raw\": "
+			   << c[PERF_RAW] << "}";
+		}
+		os << "\n  ]";
+	}
+
+private:
+
+	MatrixPerf() : _dropped(0)
+	{
+	}
+
+	static double _ratio(unsigned long long part, unsigned long long whole)
+	{
+		return whole > 0 ? (double)part / whole : 0;
+	}
+
+	mutable std :: mutex _mutex; /**< Guards _totals. */
+	std :: map<Key, MatrixPerfTotals> _totals; /**< Totals by operation and size class. */
+	std :: atomic<unsigned long long> _dropped; /**< Additions that could not be stored. */
+};
+
+/**
+ * @brief Reads the counters of the calling thread at its creation and destruction and adds the
+ * difference to an operation
+ */
+class MatrixPerfScope
+{
+public:
+
+	/**
+	 * @brief Reads the counters at the start of a kernel
+	 * @param name of the operation, a string literal
+	 * @param number of cells of the operation
+	 * @param number of calls of the operation this scope stands for (0 for a chunk of one)
+	 */
+	MatrixPerfScope(const char *op, unsigned long long cells, unsigned long long calls) :
+		_op(op), _cells(cells), _calls(calls)
+	{
+		MatrixThreadCounters :: current().read(_start);
+	}
+
+	/**
+	 * @brief Reads the counters at the end of the kernel and adds the difference
+	 */
+	~MatrixPerfScope()
+	{
+		unsigned long long end[PERF_COUNTERS];
+		MatrixThreadCounters :: current().read(end);
+		for(int i = 0; i < PERF_COUNTERS; ++i)
+		{
+			end[i] = end[i] >= _start[i] ? end[i] - _start[i] : 0;
+		}
+		MatrixPerf :: instance().add(_op, _cells, end, _calls);
+	}
+
+	MatrixPerfScope(const MatrixPerfScope&) = delete;
+	MatrixPerfScope& operator=(const MatrixPerfScope&) = delete;
+
+private:
+
+	const char *_op; /**< Name of the operation. */
+	unsigned long long _cells; /**< Number of cells of the operation. */
+	unsigned long long _calls; /**< Calls this scope adds. */
+	unsigned long long _start[PERF_COUNTERS]; /**< Counters at the start. */
+};
+
+/*
+ * @def MATRIX_PERF_SCOPE
+ * @brief counts the rest of the enclosing block as one call of an operation
+ */
+#define MATRIX_PERF_SCOPE(op, cells) MatrixPerfScope matrixPerfScope(op, cells, 1)
+
+/*
+ * @def MATRIX_PERF_CHUNK
+ * @brief counts the rest of the enclosing block as part of a call of an operation
+ */
+#define MATRIX_PERF_CHUNK(op, cells) MatrixPerfScope matrixPerfScope(op, cells, 0)
+
+/*
+ * @def MATRIX_PERF_CALL
+ * @brief counts a call of an operation whose kernels are counted as chunks
+ */
+#define MATRIX_PERF_CALL(op, cells) MatrixPerf :: instance().add(op, cells, nullptr, 1)
+
+#else
+
+#define MATRIX_PERF_SCOPE(op, cells)
+#define MATRIX_PERF_CHUNK(op, cells) ((void)(op), (void)(cells))
+#define MATRIX_PERF_CALL(op, cells) ((void)(op), (void)(cells))
+
+#endif
+
+#endif
@@ -0,0 +1,528 @@
+/********************************************************************************
+ * @file MatrixQuantized.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard QuantizedMatrix header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard QuantizedMatrix header.
+ *
+ * This header provides matrices of 8 or 16 bit integers standing for real numbers through an
+ * affine mapping, real = scale * (cell - zeroPoint), the way inference code stores weights and
+ * activations in a quarter or half of the bytes of a float.
+ *
+ * The header provides the following features:
+ *  - quantizing a Matrix<float>, with a scale and zero point chosen from its range or given
+ *  - dequantizing back to a Matrix<float>
+ *  - multiplying two quantized matrices with products accumulated in int32, into a Matrix<int>
+ *    of the accumulators or straight into the dequantized Matrix<float>
+ *
+ * The multiplication uses the vector instructions the processor has, checked at runtime: the
+ * VNNI dot products (vpdpbusd, vpdpwssd), else the AVX2 multiply adds (pmaddubsw, pmaddwd),
+ * else a plain loop. Cells are kept in the symmetric range [-max, max] of their type, so the
+ * 8 bit multiply adds never saturate. Like the instructions, the accumulators are 32 bit: with
+ * 16 bit cells the sum over the inner dimension must fit an int32. The rows of the product are
+ * split between the pool threads when Matrix<int> is in parallel mode.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws BadDimensionException when dimensions don't match desired action, std :: out_of_range
+ * for an index out of bounds and std :: invalid_argument for a scale that is not positive.
+ ********************************************************************************/
+
+#ifndef MATRIX_QUANTIZED_H
+#define MATRIX_QUANTIZED_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "BadDimensionException.h"
+#include "Matrix.hpp"
+#include "MatrixAllocator.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTIZED_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * @def SCALE_MESSAGE
+ * @brief print message for a scale that is not positive
+ */
+#define SCALE_MESSAGE "Quantization scale must be positive."
+
+/**
+ * @brief Dot product of two vectors of quantized cells, accumulated in int32
+ * @param first vector
+ * @param second vector
+ * @param length of the vectors
+ * @return the dot product
+ */
+template <typename Q>
+inline int32_t quantizedDotScalar(const Q *first, const Q *second, size_t length)
+{
+	int32_t sum = 0;
+	for(size_t k = 0; k < length; ++k)
+	{
+		sum += (int32_t)first[k] * second[k];
+	}
+	return sum;
+}
+
+#ifdef QUANTIZED_X86
+
+/**
+ * @brief Sum of the eight int32 lanes of a vector
+ * @param the vector
+ * @return the sum
+ */
+__attribute__((target("avx2")))
+inline int32_t quantizedLaneSum(__m256i lanes)
+{
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+}
+
+/**
+ * @brief quantizedDotScalar of 8 bit cells with AVX2. pmaddubsw multiplies unsigned by signed
+ * bytes, so the first vector is made positive and its signs moved onto the second.
+ * @see quantizedDotScalar
+ */
+__attribute__((target("avx2")))
+inline int32_t quantizedDotAvx2(const int8_t *first, const int8_t *second, size_t length)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	size_t k = 0;
+	for(; k + 32 <= length; k += 32)
+	{
+		const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + k));
+		const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + k));
+		const __m256i pairs = _mm256_maddubs_epi16(_mm256_sign_epi8(left, left),
+												   _mm256_sign_epi8(right, left));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+	}
+	return quantizedLaneSum(sum) + quantizedDotScalar(first + k, second + k, length - k);
+}
+
+/**
+ * @brief quantizedDotScalar of 16 bit cells with AVX2 pmaddwd
+ * @see quantizedDotScalar
+ */
+__attribute__((target("avx2")))
+inline int32_t quantizedDotAvx2(const int16_t *first, const int16_t *second, size_t length)
+{
+	__m256i sum = _mm256_setzero_si256();
+	size_t k = 0;
+	for(; k + 16 <= length; k += 16)
+	{
+		const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + k));
+		const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + k));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(left, right));
+	}
+	return quantizedLaneSum(sum) + quantizedDotScalar(first + k, second + k, length - k);
+}
+
+/**
+ * @brief quantizedDotScalar of 8 bit cells with the VNNI vpdpbusd, with the signs moved like
+ * quantizedDotAvx2 does
+ * @see quantizedDotScalar
+ */
+__attribute__((target("avx2,avx512vl,avx512vnni")))
+inline int32_t quantizedDotVnni(const int8_t *first, const int8_t *second, size_t length)
+{
+	__m256i sum = _mm256_setzero_si256();
+	size_t k = 0;
+	for(; k + 32 <= length; k += 32)
+	{
+		const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + k));
+		const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + k));
+		sum = _mm256_dpbusd_epi32(sum, _mm256_sign_epi8(left, left), _mm256_sign_epi8(right, left));
+	}
+	return quantizedLaneSum(sum) + quantizedDotScalar(first + k, second + k, length - k);
+}
+
+/**
+ * @brief quantizedDotScalar of 16 bit cells with the VNNI vpdpwssd
+ * @see quantizedDotScalar
+ */
+__attribute__((target("avx2,avx512vl,avx512vnni")))
+inline int32_t quantizedDotVnni(const int16_t *first, const int16_t *second, size_t length)
+{
+	__m256i sum = _mm256_setzero_si256();
+	size_t k = 0;
+	for(; k + 16 <= length; k += 16)
+	{
+		const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + k));
+		const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + k));
+		sum = _mm256_dpwssd_epi32(sum, left, right);
+	}
+	return quantizedLaneSum(sum) + quantizedDotScalar(first + k, second + k, length - k);
+}
+
+#endif
+
+/**
+ * @brief A matrix of 8 or 16 bit integers standing for the real numbers
+ * scale * (cell - zeroPoint)
+ */
+template <typename Q>
+class QuantizedMatrix
+{
+	static_assert(std :: is_same<Q, int8_t>::value || std :: is_same<Q, int16_t>::value,
+				  "QuantizedMatrix cells are int8_t or int16_t");
+
+public:
+
+	/**
+	 * @brief A constructor which receives the dimensions, the cells and their mapping
+	 * @param row dimension
+	 * @param column dimension
+	 * @param cells in row major order, kept in [-max, max] of their type
+	 * @param size of a step between two cells
+	 * @param cell standing for the real number 0
+	 */
+	QuantizedMatrix(unsigned int rowAmnt, unsigned int colAmnt, const std :: vector<Q>& cells,
+					float scale, int32_t zeroPoint) : _rowNum(rowAmnt), _colNum(colAmnt),
+													  _scale(scale), _zeroPoint(zeroPoint)
+	{
+		if((size_t)rowAmnt * colAmnt != cells.size() || ((!rowAmnt)^(!colAmnt)))
+		{
+			throw BadDimensionException(CONSTRUCTOR_MESSAGE);
+		}
+		if(!(scale > 0))
+		{
+			throw std :: invalid_argument(SCALE_MESSAGE);
+		}
+		_cells.resize(cells.size());
+		for(size_t i = 0; i < cells.size(); ++i)
+		{
+			_cells[i] = std :: max<Q>(-_limit(), std :: min<Q>(_limit(), cells[i]));
+		}
+	}
+
+	/**
+	 * @brief Quantizes a matrix with a scale and zero point mapping its range, widened to hold
+	 * 0, onto the whole range of the cells
+	 * @param the matrix
+	 * @return the quantized matrix
+	 */
+	static QuantizedMatrix<Q> quantize(const Matrix<float> &matrix)
+	{
+		float low = matrix.reduce(0.0f, [](float first, float second)
+		{
+			return std :: min(first, second);
+		});
+		float high = matrix.reduce(0.0f, [](float first, float second)
+		{
+			return std :: max(first, second);
+		});
+		float scale = (high - low) / (2.0f * _limit());
+		if(!(scale > 0))
+		{
+			scale = 1;
+		}
+		const int32_t zeroPoint = (int32_t)std :: lround(-_limit() - low / scale);
+		return quantize(matrix, scale, std :: max<int32_t>(-_limit(),
+														   std :: min<int32_t>(_limit(), zeroPoint)));
+	}
+
+	/**
+	 * @brief Quantizes a matrix with a given scale and zero point. Cells out of the range of the
+	 * type are clamped.
+	 * @param the matrix
+	 * @param size of a step between two cells
+	 * @param cell standing for the real number 0
+	 * @return the quantized matrix
+	 */
+	static QuantizedMatrix<Q> quantize(const Matrix<float> &matrix, float scale, int32_t zeroPoint)
+	{
+		if(!(scale > 0))
+		{
+			throw std :: invalid_argument(SCALE_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("quantize", matrix.rows(), matrix.cols(),
+						   (size_t)matrix.rows() * matrix.cols() * (sizeof(float) + sizeof(Q)), 1);
+		QuantizedMatrix<Q> result(matrix.rows(), matrix.cols(), scale, zeroPoint);
+		const Matrix<float> rowMajor = matrix.toLayout(LAYOUT_ROW_MAJOR);
+		const float *in = rowMajor._data();
+		Q *out = result._cells.data();
+		const size_t colAmnt = matrix.cols();
+		Matrix<float> :: _forEachRow(Matrix<float> :: _tuning(KERNEL_ADD), "quantize",
+									 (size_t)matrix.rows() * colAmnt, matrix.rows(), colAmnt,
+									 [=](size_t first, size_t last)
+		{
+			for(size_t i = first * colAmnt; i < last * colAmnt; ++i)
+			{
+				const long cell = std :: lround(in[i] / scale) + zeroPoint;
+				out[i] = (Q)std :: max<long>(-_limit(), std :: min<long>(_limit(), cell));
+			}
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Returns the real numbers the cells stand for
+	 * @return a new Matrix we created
+	 */
+	Matrix<float> dequantize() const
+	{
+		Matrix<float> result(rows(), cols(), typename Matrix<float> :: _Uninitialized());
+		float *out = result._mutableData();
+		const Q *in = _cells.data();
+		const float scale = _scale;
+		const int32_t zeroPoint = _zeroPoint;
+		const size_t colAmnt = cols();
+		Matrix<float> :: _forEachRow(Matrix<float> :: _tuning(KERNEL_ADD), "dequantize",
+									 (size_t)rows() * colAmnt, rows(), colAmnt,
+									 [=](size_t first, size_t last)
+		{
+			for(size_t i = first * colAmnt; i < last * colAmnt; ++i)
+			{
+				out[i] = scale * (float)((int32_t)in[i] - zeroPoint);
+			}
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Multiplies by another quantized matrix, returning the int32 accumulators
+	 * sum of (cell - zeroPoint) * (other cell - other zeroPoint). Multiplied by both scales they
+	 * are the product of the real numbers. The columns of the other matrix are packed so both
+	 * operands of every dot product are contiguous, and the zero points are taken out of the
+	 * accumulators with the sums of the rows and columns, so the dot products run on raw cells.
+	 * @param Matrix we multiply by
+	 * @return a new Matrix of the accumulators we created
+	 */
+	Matrix<int32_t> multiplyAccumulate(const QuantizedMatrix<Q> &other) const
+	{
+		if(cols() != other.rows())
+		{
+			throw BadDimensionException(OP_MESSAGE);
+		}
+		MATRIX_TRACE_SCOPE("quantizedMultiply", rows(), other.cols(),
+						   ((size_t)rows() * cols() + (size_t)other.rows() * other.cols()) *
+						   sizeof(Q) + (size_t)rows() * other.cols() * sizeof(int32_t), 1);
+		const size_t depth = cols();
+		const size_t colAmnt = other.cols();
+		std :: vector<Q, MatrixAllocator<Q>> packed(depth * colAmnt);
+		std :: vector<int32_t> colSums(colAmnt, 0);
+		for(size_t k = 0; k < depth; ++k)
+		{
+			for(size_t j = 0; j < colAmnt; ++j)
+			{
+				packed[j * depth + k] = other._cells[k * colAmnt + j];
+				colSums[j] += other._cells[k * colAmnt + j];
+			}
+		}
+
+		Matrix<int32_t> product(rows(), other.cols(), typename Matrix<int32_t> :: _Uninitialized());
+		int32_t *out = product._mutableData();
+		const Q *left = _cells.data();
+		const Q *right = packed.data();
+		const int32_t *colSum = colSums.data();
+		const int32_t leftZero = _zeroPoint;
+		const int32_t rightZero = other._zeroPoint;
+		const Dot dot = kernel();
+		Matrix<int32_t> :: _forEachRow(Matrix<int32_t> :: _tuning(KERNEL_MULTIPLY),
+									   "quantizedMultiply", (size_t)rows() * colAmnt, rows(),
+									   depth * colAmnt, [=](size_t first, size_t last)
+		{
+			for(size_t i = first; i < last; ++i)
+			{
+				const Q *row = left + i * depth;
+				int32_t rowSum = 0;
+				for(size_t k = 0; k < depth; ++k)
+				{
+					rowSum += row[k];
+				}
+				for(size_t j = 0; j < colAmnt; ++j)
+				{
+					out[i * colAmnt + j] = dot(row, right + j * depth, depth) -
+										   rightZero * rowSum - leftZero * colSum[j] +
+										   (int32_t)depth * leftZero * rightZero;
+				}
+			}
+		});
+		return product;
+	}
+
+	/**
+	 * @brief Overrides * operator to multiply by another quantized matrix into real numbers
+	 * @param Matrix we multiply by
+	 * @return a new Matrix of the dequantized product we created
+	 */
+	Matrix<float> operator*(const QuantizedMatrix<Q> &other) const
+	{
+		const Matrix<int32_t> accumulators = multiplyAccumulate(other);
+		const float scale = _scale * other._scale;
+		Matrix<float> result(rows(), other.cols(), typename Matrix<float> :: _Uninitialized());
+		float *out = result._mutableData();
+		const int32_t *in = accumulators._data();
+		const size_t colAmnt = other.cols();
+		Matrix<float> :: _forEachRow(Matrix<float> :: _tuning(KERNEL_ADD), "dequantize",
+									 (size_t)rows() * colAmnt, rows(), colAmnt,
+									 [=](size_t first, size_t last)
+		{
+			for(size_t i = first * colAmnt; i < last * colAmnt; ++i)
+			{
+				out[i] = scale * (float)in[i];
+			}
+		});
+		return result;
+	}
+
+	/**
+	 * @brief Overrides () operator to get the cell in [row,col]
+	 * @param row number
+	 * @param col number
+	 * @return the cell
+	 */
+	Q operator()(unsigned int rowPos, unsigned int colPos) const
+	{
+		if(rowPos < OFFSET || colPos < OFFSET || rows() < rowPos || cols() < colPos)
+		{
+			throw std :: out_of_range(INDEX_MESSAGE);
+		}
+		return _cells[(size_t)(rowPos - OFFSET) * cols() + colPos - OFFSET];
+	}
+
+	/**
+	 * @brief Getter for the row dimension
+	 * @return row dimension
+	 */
+	inline unsigned int rows() const
+	{
+		return _rowNum;
+	}
+
+	/**
+	 * @brief Getter for the column dimension
+	 * @return column dimension
+	 */
+	inline unsigned int cols() const
+	{
+		return _colNum;
+	}
+
+	/**
+	 * @brief Getter for the size of a step between two cells
+	 * @return the scale
+	 */
+	inline float scale() const
+	{
+		return _scale;
+	}
+
+	/**
+	 * @brief Getter for the cell standing for the real number 0
+	 * @return the zero point
+	 */
+	inline int32_t zeroPoint() const
+	{
+		return _zeroPoint;
+	}
+
+	/**
+	 * @brief Type of a kernel taking the dot product of two vectors of cells
+	 */
+	typedef int32_t (*Dot)(const Q *, const Q *, size_t);
+
+	/**
+	 * @brief Getter for the fastest dot product kernel the processor runs, picked on first use
+	 * @return the kernel
+	 */
+	static Dot kernel()
+	{
+		static const Dot best = _pickKernel();
+		return best;
+	}
+
+	/**
+	 * @brief Getter for the name of the kernel used, vnni, avx2 or scalar
+	 * @return the name
+	 */
+	static const char *kernelName()
+	{
+#ifdef QUANTIZED_X86
+		if(kernel() == static_cast<Dot>(&quantizedDotVnni))
+		{
+			return "vnni";
+		}
+		if(kernel() == static_cast<Dot>(&quantizedDotAvx2))
+		{
+			return "avx2";
+		}
+#endif
+		return "scalar";
+	}
+
+private:
+
+	/**
+	 * @brief A constructor for cells that are written next
+	 */
+	QuantizedMatrix(unsigned int rowAmnt, unsigned int colAmnt, float scale, int32_t zeroPoint) :
+		_rowNum(rowAmnt), _colNum(colAmnt), _cells((size_t)rowAmnt * colAmnt), _scale(scale),
+		_zeroPoint(zeroPoint)
+	{
+	}
+
+	/**
+	 * @brief Largest magnitude of a cell, the range is kept symmetric
+	 * @return the limit
+	 */
+	static Q _limit()
+	{
+		return std :: numeric_limits<Q> :: max();
+	}
+
+	/**
+	 * @brief Picks the fastest dot product kernel the processor runs
+	 * @return the kernel
+	 */
+	static Dot _pickKernel()
+	{
+#ifdef QUANTIZED_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl"))
+		{
+			return &quantizedDotVnni;
+		}
+		if(__builtin_cpu_supports("avx2"))
+		{
+			return &quantizedDotAvx2;
+		}
+#endif
+		return &quantizedDotScalar<Q>;
+	}
+
+	unsigned int _rowNum; /**< Row dimension. */
+	unsigned int _colNum; /**< Column dimension. */
+	std :: vector<Q, MatrixAllocator<Q>> _cells; /**< Cells in row major order. */
+	float _scale; /**< Size of a step between two cells. */
+	int32_t _zeroPoint; /**< Cell standing for the real number 0. */
+};
+
+/**
+ * @brief Quantized matrix of 8 bit cells
+ */
+typedef QuantizedMatrix<int8_t> QuantizedMatrix8;
+
+/**
+ * @brief Quantized matrix of 16 bit cells
+ */
+typedef QuantizedMatrix<int16_t> QuantizedMatrix16;
+
+#endif
@@ -0,0 +1,917 @@
+/********************************************************************************
+ * @file MatrixServer.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard MatrixServer header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard MatrixServer header.
+ *
+ * A MatrixServer lets the processes of a machine share matrices instead of each loading its own
+ * copy. The server publishes matrices as POSIX shared memory objects holding a matrix file
+ * (see MatrixFile.h), which the clients map read only and use in place without copying a cell.
+ *
+ * Clients connect to the server over a Unix domain socket and send it jobs naming shared
+ * operands: multiply, add and transpose. The operands are matrices the server published or
+ * results of its jobs, a client publishes its own matrices through the server first. The server
+ * runs the jobs on the shared ThreadPool, writes every result to a new shared memory object and
+ * replies with its name, which the client maps like any other shared matrix and releases once
+ * done with it. A job may name the result of an earlier job as an operand. A client can only
+ * release the results of its own connection, the published matrices are only unlinked by the
+ * server.
+ *
+ * Requests and replies are fixed size records. The server reads and writes them without ever
+ * waiting, so a client that sends part of a request or does not read its replies holds up no one
+ * else: the replies are queued and sent by the serving thread as the client reads them, and the
+ * requests of a connection with CONNECTION_JOBS jobs unreplied are left unread. A connection
+ * has at most one job in flight from a MatrixClient, so several threads of a process that want
+ * their jobs to run concurrently each use a client of their own.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws std :: runtime_error when the socket cannot be opened or a job fails, std ::
+ * invalid_argument for a name that is not a shared memory name, and BadDimensionException when
+ * the dimensions of the operands of a job don't match.
+ ********************************************************************************/
+
+#ifndef MATRIX_SERVER_H
+#define MATRIX_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Matrix.hpp"
+
+/*
+ * @def SHARED_NAME_LENGTH
+ * @brief bytes of a shared memory name in a request or reply, its terminating '\0' included
+ */
+#define SHARED_NAME_LENGTH 64
+
+/*
+ * @def JOB_MESSAGE_LENGTH
+ * @brief bytes of the error message of a reply, its terminating '\0' included
+ */
+#define JOB_MESSAGE_LENGTH 128
+
+/*
+ * @def SERVER_BACKLOG
+ * @brief connections waiting to be accepted by the server
+ */
+#define SERVER_BACKLOG 16
+
+/*
+ * @def CONNECTION_JOBS
+ * @brief jobs of a connection running or with their reply unsent, past which its requests are
+ * left unread
+ */
+#define CONNECTION_JOBS 16
+
+/*
+ * @def RESULT_PREFIX
+ * @brief start of the names of the results, followed by the process id of the server
+ */
+#define RESULT_PREFIX "/matrix."
+
+/*
+ * @def SOCKET_MESSAGE
+ * @brief print message for a server socket that cannot be opened
+ */
+#define SOCKET_MESSAGE "Cannot open matrix server socket: "
+
+/*
+ * @def CONNECT_MESSAGE
+ * @brief print message for a server that cannot be reached
+ */
+#define CONNECT_MESSAGE "Cannot reach matrix server: "
+
+/*
+ * @def NAME_MESSAGE
+ * @brief print message for a name that is not a shared memory name
+ */
+#define NAME_MESSAGE "Not a valid shared matrix name: "
+
+/*
+ * @def JOB_TYPE_MESSAGE
+ * @brief print message for operands the server cannot compute with
+ */
+#define JOB_TYPE_MESSAGE "Matrix operands are not of one known element type."
+
+/*
+ * @def RELEASE_MESSAGE
+ * @brief print message for a release of an object that is not a result of the connection
+ */
+#define RELEASE_MESSAGE "Not a result of this connection: "
+
+/*
+ * @def OPERAND_MESSAGE
+ * @brief print message for an operand that is neither published nor a result of the server
+ */
+#define OPERAND_MESSAGE "Not a matrix of the server, publish it first: "
+
+/**
+ * @brief Jobs a client can send
+ */
+enum MatrixJob : uint32_t
+{
+	JOB_MULTIPLY = 1, /**< left * right */
+	JOB_ADD, /**< left + right */
+	JOB_TRANSPOSE, /**< left transposed */
+	JOB_RELEASE /**< unlink left, a result of an earlier job of the same connection */
+};
+
+/**
+ * @brief Outcomes of a job
+ */
+enum MatrixJobStatus : int32_t
+{
+	JOB_OK = 0,
+	JOB_BAD_DIMENSION, /**< The dimensions of the operands don't match. */
+	JOB_FAILED /**< Any other failure, described by the message. */
+};
+
+/**
+ * @brief A job sent by a client
+ */
+struct MatrixJobRequest
+{
+	uint64_t id; /**< Number of the request, repeated in its reply. */
+	uint32_t job; /**< One of MatrixJob. */
+	uint32_t reserved; /**< Zero. */
+	char left[SHARED_NAME_LENGTH]; /**< Name of the first operand. */
+	char right[SHARED_NAME_LENGTH]; /**< Name of the second operand, empty for one operand. */
+};
+
+/**
+ * @brief The reply of the server to a job
+ */
+struct MatrixJobReply
+{
+	uint64_t id; /**< Number of the request. */
+	int32_t status; /**< One of MatrixJobStatus. */
+	uint32_t reserved; /**< Zero. */
+	char result[SHARED_NAME_LENGTH]; /**< Name of the result, empty for a release. */
+	char message[JOB_MESSAGE_LENGTH]; /**< What went wrong, for a job that failed. */
+};
+
+/**
+ * @brief Checks whether a name can name a shared matrix: a '/' followed by at least one
+ * character and no other '/', short enough to fit a request
+ * @param the name
+ * @return true if it is valid, false otherwise
+ */
+inline bool isSharedMatrixName(const std :: string& name)
+{
+	return name.size() > 1 && name.size() < SHARED_NAME_LENGTH && name[0] == '/' &&
+		   name.find('/', 1) == std :: string :: npos;
+}
+
+/**
+ * @brief Copies a name into a fixed size field, throwing if it is not a shared memory name
+ * @param the field
+ * @param the name
+ */
+inline void copySharedMatrixName(char (&field)[SHARED_NAME_LENGTH], const std :: string& name)
+{
+	if(!isSharedMatrixName(name))
+	{
+		throw std :: invalid_argument(NAME_MESSAGE + name);
+	}
+	std :: strncpy(field, name.c_str(), SHARED_NAME_LENGTH);
+}
+
+/**
+ * @brief Writes a whole record to a socket, without raising SIGPIPE if the peer is gone
+ * @param the socket
+ * @param the record
+ * @param size of the record in bytes
+ * @return true if it was written, false otherwise
+ */
+inline bool writeSocket(int fd, const void *record, size_t length)
+{
+	const char *cursor = static_cast<const char *>(record);
+	while(length > 0)
+	{
+		ssize_t written = ::send(fd, cursor, length, MSG_NOSIGNAL);
+		if(written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(written <= 0)
+		{
+			return false;
+		}
+		cursor += written;
+		length -= written;
+	}
+	return true;
+}
+
+/**
+ * @brief Reads a whole record from a socket
+ * @param the socket
+ * @param the record
+ * @param size of the record in bytes
+ * @return true if it was read, false if the peer is gone
+ */
+inline bool readSocket(int fd, void *record, size_t length)
+{
+	char *cursor = static_cast<char *>(record);
+	while(length > 0)
+	{
+		ssize_t got = ::recv(fd, cursor, length, 0);
+		if(got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(got <= 0)
+		{
+			return false;
+		}
+		cursor += got;
+		length -= got;
+	}
+	return true;
+}
+
+/**
+ * @brief Fills the address of a Unix domain socket
+ * @param path of the socket
+ * @param the address
+ * @return true if the path fits, false otherwise
+ */
+inline bool socketAddress(const std :: string& path, sockaddr_un& address)
+{
+	std :: memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(path.empty() || path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	std :: memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+/**
+ * @brief Server publishing shared matrices and running the jobs of its clients
+ */
+class MatrixServer
+{
+public:
+
+	/**
+	 * @brief Constructor that listens on a Unix domain socket and starts serving. A socket file
+	 * left at the path by a server that is gone is replaced.
+	 * @param path of the socket
+	 */
+	explicit MatrixServer(const std :: string& socketPath) :
+		_path(socketPath), _resultPrefix(RESULT_PREFIX + std :: to_string(::getpid()) + "."),
+		_resultAmnt(0), _stopping(false), _pending(0)
+	{
+		sockaddr_un address;
+		_wake[0] = _wake[1] = -1;
+		_listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(_listener >= 0 && socketAddress(_path, address))
+		{
+			::unlink(_path.c_str());
+		}
+		if(_listener < 0 || !socketAddress(_path, address) ||
+		   ::bind(_listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+		   ::listen(_listener, SERVER_BACKLOG) != 0 || ::pipe2(_wake, O_NONBLOCK | O_CLOEXEC) != 0)
+		{
+			if(_listener >= 0)
+			{
+				::close(_listener);
+			}
+			throw std :: runtime_error(SOCKET_MESSAGE + _path);
+		}
+		_thread = std :: thread(&MatrixServer :: _serve, this);
+	}
+
+	/**
+	 * @brief Destructor that stops accepting jobs, waits for the jobs running, and unlinks the
+	 * socket and every matrix the server created. Clients that mapped them keep their mappings.
+	 */
+	~MatrixServer()
+	{
+		_stopping = true;
+		_wakeUp();
+		_thread.join();
+		{
+			std :: unique_lock<std :: mutex> lock(_mutex);
+			_idle.wait(lock, [this]() { return _pending == 0; });
+		}
+		::close(_listener);
+		::close(_wake[0]);
+		::close(_wake[1]);
+		::unlink(_path.c_str());
+		for(std :: set<std :: string> :: const_iterator it = _owned.begin(); it != _owned.end(); ++it)
+		{
+			unlinkSharedMatrixFile(*it);
+		}
+	}
+
+	MatrixServer(const MatrixServer&) = delete;
+	MatrixServer& operator=(const MatrixServer&) = delete;
+
+	/**
+	 * @brief Publishes a copy of a matrix for the clients to map
+	 * @param name of the shared matrix, "/name"
+	 * @param the matrix
+	 */
+	template <typename T>
+	void publish(const std :: string& name, const Matrix<T>& matrix)
+	{
+		if(!isSharedMatrixName(name))
+		{
+			throw std :: invalid_argument(NAME_MESSAGE + name);
+		}
+		matrix.saveShared(name);
+		_own(name);
+	}
+
+	/**
+	 * @brief Publishes the matrix of a matrix file for the clients to map, copying the file as it
+	 * is whatever its element type
+	 * @param name of the shared matrix, "/name"
+	 * @param path of the matrix file
+	 */
+	void publish(const std :: string& name, const std :: string& path)
+	{
+		if(!isSharedMatrixName(name))
+		{
+			throw std :: invalid_argument(NAME_MESSAGE + name);
+		}
+		MappedMatrixFile file(path);
+		writeSharedMatrixFile(name, file.header(), file.bytes() + file.header().dataOffset);
+		_own(name);
+	}
+
+	/**
+	 * @brief Unlinks a matrix the server created, published or a result
+	 * @param name of the shared matrix
+	 * @return true if it was unlinked, false if the server did not create it
+	 */
+	bool unpublish(const std :: string& name)
+	{
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			if(_owned.erase(name) == 0)
+			{
+				return false;
+			}
+		}
+		return unlinkSharedMatrixFile(name);
+	}
+
+	/**
+	 * @brief Getter for the path of the socket
+	 * @return the path
+	 */
+	const std :: string& path() const
+	{
+		return _path;
+	}
+
+private:
+
+	/**
+	 * @brief A client connection, closed once the server and its running jobs are done with it
+	 */
+	struct _Connection
+	{
+		/**
+		 * @brief Constructor taking an accepted socket
+		 * @param the socket
+		 */
+		explicit _Connection(int socket) : fd(socket), sent(0), received(0), jobs(0)
+		{
+		}
+
+		/**
+		 * @brief Destructor closing the socket
+		 */
+		~_Connection()
+		{
+			::close(fd);
+		}
+
+		int fd; /**< The socket. */
+		std :: mutex mutex; /**< Guards replies and results. */
+		std :: deque<MatrixJobReply> replies; /**< Replies of finished jobs not yet sent. */
+		size_t sent; /**< Bytes of the first reply sent so far. */
+		MatrixJobRequest request; /**< The request being received. */
+		size_t received; /**< Bytes of the request received so far. */
+		size_t jobs; /**< Jobs submitted whose reply is not sent yet, kept by the serving thread. */
+		std :: set<std :: string> results; /**< Results of the connection not released yet. */
+	};
+
+	/**
+	 * @brief Records a matrix the server created, to unlink it when done
+	 * @param name of the shared matrix
+	 */
+	void _own(const std :: string& name)
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		_owned.insert(name);
+	}
+
+	/**
+	 * @brief Wakes the serving thread, to send new replies or to stop
+	 */
+	void _wakeUp()
+	{
+		// a full pipe wakes it up just as well
+		while(::write(_wake[1], "", 1) < 0 && errno == EINTR)
+		{
+		}
+	}
+
+	/**
+	 * @brief Accepts connections, reads their requests and sends their replies until the server
+	 * is destroyed
+	 */
+	void _serve()
+	{
+		std :: vector<std :: shared_ptr<_Connection>> connections;
+		std :: vector<pollfd> fds;
+		while(true)
+		{
+			// a client that hung up is dropped, the jobs it still has running keep its socket
+			for(size_t i = connections.size(); i-- > 0;)
+			{
+				if(!_send(connections[i]))
+				{
+					connections.erase(connections.begin() + i);
+				}
+			}
+			fds.assign(2 + connections.size(), pollfd());
+			fds[0].fd = _wake[0];
+			fds[0].events = POLLIN;
+			fds[1].fd = _listener;
+			fds[1].events = POLLIN;
+			for(size_t i = 0; i < connections.size(); ++i)
+			{
+				std :: lock_guard<std :: mutex> lock(connections[i]->mutex);
+				fds[2 + i].fd = connections[i]->fd;
+				fds[2 + i].events = (connections[i]->jobs < CONNECTION_JOBS ? POLLIN : 0) |
+									(connections[i]->replies.empty() ? 0 : POLLOUT);
+			}
+			if(::poll(fds.data(), fds.size(), -1) < 0)
+			{
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				return;
+			}
+			if(fds[0].revents)
+			{
+				char drained[64];
+				while(::read(_wake[0], drained, sizeof(drained)) > 0)
+				{
+				}
+				if(_stopping)
+				{
+					return;
+				}
+			}
+			for(size_t i = connections.size(); i-- > 0;)
+			{
+				const short events = fds[2 + i].revents;
+				if((events & POLLIN) ? !_receive(connections[i]) :
+					(events & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+				{
+					connections.erase(connections.begin() + i);
+				}
+			}
+			if(fds[1].revents & POLLIN)
+			{
+				int fd = ::accept4(_listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if(fd >= 0)
+				{
+					connections.push_back(std :: make_shared<_Connection>(fd));
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Sends the queued replies of a client as far as its socket takes them without waiting
+	 * @param connection of the client
+	 * @return false if the socket failed, true otherwise
+	 */
+	bool _send(const std :: shared_ptr<_Connection>& connection)
+	{
+		std :: lock_guard<std :: mutex> lock(connection->mutex);
+		while(!connection->replies.empty())
+		{
+			const char *cursor = reinterpret_cast<const char *>(&connection->replies.front()) +
+								 connection->sent;
+			ssize_t written = ::send(connection->fd, cursor,
+									 sizeof(MatrixJobReply) - connection->sent,
+									 MSG_DONTWAIT | MSG_NOSIGNAL);
+			if(written < 0)
+			{
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			connection->sent += written;
+			if(connection->sent == sizeof(MatrixJobReply))
+			{
+				connection->replies.pop_front();
+				connection->sent = 0;
+				--connection->jobs;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Reads what a client has sent so far without waiting for the rest, and submits the
+	 * request once all of it is in. A single read per call, so a client sending many requests
+	 * takes turns with the others.
+	 * @param connection of the client
+	 * @return false if the client hung up or the socket failed, true otherwise
+	 */
+	bool _receive(const std :: shared_ptr<_Connection>& connection)
+	{
+		char *cursor = reinterpret_cast<char *>(&connection->request) + connection->received;
+		ssize_t got;
+		do
+		{
+			got = ::recv(connection->fd, cursor, sizeof(MatrixJobRequest) - connection->received,
+						 MSG_DONTWAIT);
+		}
+		while(got < 0 && errno == EINTR);
+		if(got < 0)
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		if(got == 0)
+		{
+			return false;
+		}
+		connection->received += got;
+		if(connection->received == sizeof(MatrixJobRequest))
+		{
+			connection->received = 0;
+			++connection->jobs;
+			_submit(connection, connection->request);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Runs a job on the shared pool and queues its reply for the serving thread to send, so
+	 * a worker never waits on a client
+	 * @param connection of the client
+	 * @param the job
+	 */
+	void _submit(const std :: shared_ptr<_Connection>& connection, const MatrixJobRequest& request)
+	{
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			++_pending;
+		}
+		ThreadPool :: shared().submit([this, connection, request]()
+		{
+			MatrixJobReply reply = _run(*connection, request);
+			{
+				std :: lock_guard<std :: mutex> lock(connection->mutex);
+				connection->replies.push_back(reply);
+			}
+			_wakeUp();
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			if(--_pending == 0)
+			{
+				_idle.notify_all();
+			}
+		});
+	}
+
+	/**
+	 * @brief Runs a job
+	 * @param connection of the client, owning the result
+	 * @param the job
+	 * @return the reply to the client
+	 */
+	MatrixJobReply _run(_Connection& connection, MatrixJobRequest request)
+	{
+		MatrixJobReply reply;
+		std :: memset(&reply, 0, sizeof(reply));
+		reply.id = request.id;
+		request.left[SHARED_NAME_LENGTH - 1] = request.right[SHARED_NAME_LENGTH - 1] = '\0';
+		try
+		{
+			if(!isSharedMatrixName(request.left))
+			{
+				throw std :: invalid_argument(NAME_MESSAGE + std :: string(request.left));
+			}
+			if(request.job == JOB_RELEASE)
+			{
+				bool ours;
+				{
+					std :: lock_guard<std :: mutex> lock(connection.mutex);
+					ours = connection.results.erase(request.left) != 0;
+				}
+				if(!ours || !unpublish(request.left))
+				{
+					throw std :: runtime_error(RELEASE_MESSAGE + std :: string(request.left));
+				}
+				return reply;
+			}
+			const std :: string result = _resultPrefix + std :: to_string(++_resultAmnt);
+			_compute(request, result);
+			_own(result);
+			{
+				std :: lock_guard<std :: mutex> lock(connection.mutex);
+				connection.results.insert(result);
+			}
+			std :: strncpy(reply.result, result.c_str(), SHARED_NAME_LENGTH - 1);
+		}
+		catch (BadDimensionException &e)
+		{
+			reply.status = JOB_BAD_DIMENSION;
+			std :: strncpy(reply.message, e.what(), JOB_MESSAGE_LENGTH - 1);
+		}
+		catch (std :: exception &e)
+		{
+			reply.status = JOB_FAILED;
+			std :: strncpy(reply.message, e.what(), JOB_MESSAGE_LENGTH - 1);
+		}
+		return reply;
+	}
+
+	/**
+	 * @brief Maps an operand of a job. Only the matrices the server created are mapped, a client
+	 * could shrink an object of its own while a job reads it and kill the server with SIGBUS.
+	 * @param name of the shared matrix
+	 * @return the mapping
+	 */
+	std :: shared_ptr<const MappedMatrixFile> _openOwned(const std :: string& name)
+	{
+		// unpublish erases a name before unlinking it, so under the lock the name is still ours
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		if(_owned.count(name) == 0)
+		{
+			throw std :: runtime_error(OPERAND_MESSAGE + name);
+		}
+		return MappedMatrixFile :: openShared(name);
+	}
+
+	/**
+	 * @brief Maps the operands of a job and computes its result with the element type they hold
+	 * @param the job
+	 * @param name of the result
+	 */
+	void _compute(const MatrixJobRequest& request, const std :: string& result)
+	{
+		std :: shared_ptr<const MappedMatrixFile> left = _openOwned(request.left);
+		std :: shared_ptr<const MappedMatrixFile> right;
+		if(request.job != JOB_TRANSPOSE)
+		{
+			if(!isSharedMatrixName(request.right))
+			{
+				throw std :: invalid_argument(NAME_MESSAGE + std :: string(request.right));
+			}
+			right = _openOwned(request.right);
+			if(right->header().dtype != left->header().dtype ||
+			   right->header().elemSize != left->header().elemSize)
+			{
+				throw std :: runtime_error(JOB_TYPE_MESSAGE);
+			}
+		}
+		switch(left->header().dtype)
+		{
+			case DTYPE_INT8:
+				return _compute<int8_t>(request.job, left, right, result);
+			case DTYPE_UINT8:
+				return _compute<uint8_t>(request.job, left, right, result);
+			case DTYPE_INT16:
+				return _compute<int16_t>(request.job, left, right, result);
+			case DTYPE_UINT16:
+				return _compute<uint16_t>(request.job, left, right, result);
+			case DTYPE_INT32:
+				return _compute<int32_t>(request.job, left, right, result);
+			case DTYPE_UINT32:
+				return _compute<uint32_t>(request.job, left, right, result);
+			case DTYPE_INT64:
+				return _compute<int64_t>(request.job, left, right, result);
+			case DTYPE_UINT64:
+				return _compute<uint64_t>(request.job, left, right, result);
+			case DTYPE_FLOAT:
+				return _compute<float>(request.job, left, right, result);
+			case DTYPE_DOUBLE:
+				return _compute<double>(request.job, left, right, result);
+			case DTYPE_COMPLEX:
+				return _compute<Complex>(request.job, left, right, result);
+			default:
+				throw std :: runtime_error(JOB_TYPE_MESSAGE);
+		}
+	}
+
+	/**
+	 * @brief Computes the result of a job on operands of type T, used in place, and writes it to
+	 * a new shared matrix
+	 * @param one of MatrixJob
+	 * @param the first operand
+	 * @param the second operand, nullptr for a transpose
+	 * @param name of the result
+	 */
+	template <typename T>
+	void _compute(uint32_t job, const std :: shared_ptr<const MappedMatrixFile>& left,
+				  const std :: shared_ptr<const MappedMatrixFile>& right, const std :: string& result)
+	{
+		const Matrix<T> first(left);
+		switch(job)
+		{
+			case JOB_MULTIPLY:
+				(first * Matrix<T>(right)).saveShared(result);
+				break;
+			case JOB_ADD:
+				(first + Matrix<T>(right)).saveShared(result);
+				break;
+			case JOB_TRANSPOSE:
+				first.trans().saveShared(result);
+				break;
+			default:
+				throw std :: runtime_error(JOB_TYPE_MESSAGE);
+		}
+	}
+
+	std :: string _path; /**< Path of the socket. */
+	std :: string _resultPrefix; /**< Start of the names of the results. */
+	std :: atomic<size_t> _resultAmnt; /**< Results named so far. */
+	int _listener; /**< The listening socket. */
+	int _wake[2]; /**< Pipe waking the serving thread to send replies or to stop. */
+	std :: atomic<bool> _stopping; /**< Set by the destructor to stop the serving thread. */
+	std :: thread _thread; /**< Thread accepting connections and reading requests. */
+	std :: mutex _mutex; /**< Guards _owned and _pending. */
+	std :: condition_variable _idle; /**< Notified when no job is running. */
+	std :: set<std :: string> _owned; /**< Shared matrices we created. */
+	size_t _pending; /**< Jobs submitted and not yet replied to. */
+};
+
+/**
+ * @brief Connection of a process to a MatrixServer. Calls from several threads are run one at a
+ * time.
+ */
+class MatrixClient
+{
+public:
+
+	/**
+	 * @brief Constructor connecting to a server
+	 * @param path of the socket of the server
+	 */
+	explicit MatrixClient(const std :: string& socketPath) : _path(socketPath), _requestAmnt(0)
+	{
+		sockaddr_un address;
+		_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(_fd < 0 || !socketAddress(_path, address) ||
+		   ::connect(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+		{
+			if(_fd >= 0)
+			{
+				::close(_fd);
+			}
+			throw std :: runtime_error(CONNECT_MESSAGE + _path);
+		}
+	}
+
+	/**
+	 * @brief Destructor closing the connection, the results it did not release stay published
+	 */
+	~MatrixClient()
+	{
+		::close(_fd);
+	}
+
+	MatrixClient(const MatrixClient&) = delete;
+	MatrixClient& operator=(const MatrixClient&) = delete;
+
+	/**
+	 * @brief Maps a shared matrix read only, its cells are used in place
+	 * @param name of the shared matrix
+	 * @return a new Matrix we created
+	 */
+	template <typename T>
+	Matrix<T> map(const std :: string& name) const
+	{
+		return Matrix<T> :: mapShared(name);
+	}
+
+	/**
+	 * @brief Multiplies two matrices of the server, published or results
+	 * @param name of the left operand
+	 * @param name of the right operand
+	 * @return name of the shared result
+	 */
+	std :: string multiply(const std :: string& left, const std :: string& right)
+	{
+		return _call(JOB_MULTIPLY, left, right);
+	}
+
+	/**
+	 * @brief Adds two matrices of the server, published or results
+	 * @param name of the left operand
+	 * @param name of the right operand
+	 * @return name of the shared result
+	 */
+	std :: string add(const std :: string& left, const std :: string& right)
+	{
+		return _call(JOB_ADD, left, right);
+	}
+
+	/**
+	 * @brief Transposes a matrix of the server, published or a result
+	 * @param name of the operand
+	 * @return name of the shared result
+	 */
+	std :: string transpose(const std :: string& name)
+	{
+		return _call(JOB_TRANSPOSE, name, std :: string());
+	}
+
+	/**
+	 * @brief Asks the server to unlink the result of an earlier job of this client. Mappings of it
+	 * stay valid.
+	 * @param name of the shared matrix
+	 */
+	void release(const std :: string& name)
+	{
+		_call(JOB_RELEASE, name, std :: string());
+	}
+
+private:
+
+	/**
+	 * @brief Sends a job and waits for its reply
+	 * @param one of MatrixJob
+	 * @param name of the first operand
+	 * @param name of the second operand, empty for none
+	 * @return name of the result
+	 */
+	std :: string _call(MatrixJob job, const std :: string& left, const std :: string& right)
+	{
+		MatrixJobRequest request;
+		std :: memset(&request, 0, sizeof(request));
+		request.job = job;
+		copySharedMatrixName(request.left, left);
+		if(!right.empty())
+		{
+			copySharedMatrixName(request.right, right);
+		}
+		MatrixJobReply reply;
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			request.id = ++_requestAmnt;
+			if(!writeSocket(_fd, &request, sizeof(request)) ||
+			   !readSocket(_fd, &reply, sizeof(reply)) || reply.id != request.id)
+			{
+				throw std :: runtime_error(CONNECT_MESSAGE + _path);
+			}
+		}
+		reply.result[SHARED_NAME_LENGTH - 1] = reply.message[JOB_MESSAGE_LENGTH - 1] = '\0';
+		if(reply.status == JOB_BAD_DIMENSION)
+		{
+			throw BadDimensionException(reply.message);
+		}
+		if(reply.status != JOB_OK)
+		{
+			throw std :: runtime_error(reply.message);
+		}
+		return reply.result;
+	}
+
+	std :: string _path; /**< Path of the socket of the server. */
+	int _fd; /**< The connected socket. */
+	uint64_t _requestAmnt; /**< Requests sent so far. */
+	std :: mutex _mutex; /**< Held from sending a request to reading its reply. */
+};
+
+#endif
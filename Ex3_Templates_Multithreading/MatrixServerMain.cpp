@@ -0,0 +1,72 @@
+/********************************************************************************
+ * @file MatrixServerMain.cpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief Matrix server program for the MatrixServer.hpp file
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * Program that publishes matrix files as shared matrices and serves the jobs of MatrixClient
+ * processes until it receives SIGINT or SIGTERM. On exit it unlinks its socket, the matrices
+ * it published and the results it computed.
+ *
+ * Usage: MatrixServer socket [/name matrix-file]...
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Prints usage and exits with a failure code on wrong arguments, or prints the error and exits
+ * with a failure code when the socket cannot be opened or a file cannot be published.
+ ********************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <signal.h>
+#include "MatrixServer.hpp"
+
+/*
+ * @def USAGE
+ * @brief print message for wrong arguments
+ */
+#define USAGE "Usage: MatrixServer socket [/name matrix-file]..."
+
+/**
+ * @brief Publishes the files and serves until asked to stop
+ * @param number of arguments
+ * @param the socket path followed by pairs of a shared name and a matrix file
+ * @return EXIT_SUCCESS once stopped, EXIT_FAILURE on an error
+ */
+int main(int argc, char *argv[])
+{
+	if(argc < 2 || argc % 2 != 0)
+	{
+		std :: cerr << USAGE << std :: endl;
+		return EXIT_FAILURE;
+	}
+	// block the signals before any thread starts, so every thread inherits the mask and only
+	// sigwait receives them
+	sigset_t stop;
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+	try
+	{
+		MatrixServer server(argv[1]);
+		for(int i = 2; i < argc; i += 2)
+		{
+			server.publish(argv[i], std :: string(argv[i + 1]));
+		}
+		int signal;
+		sigwait(&stop, &signal);
+	}
+	catch (std :: exception &e)
+	{
+		std :: cerr << e.what() << std :: endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,422 @@
+/********************************************************************************
+ * @file MatrixText.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix text format header.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix text format.
+ *
+ * A matrix text is a row of cells per line, the cells separated by any run of tabs, spaces or
+ * commas, so TSV, CSV and the output of operator<< are all read. Blank lines are skipped and a
+ * carriage return before a newline is ignored.
+ *
+ * Cells are read and written by MatrixTextCodec without streams: integers by hand, floating
+ * point numbers with strtod and with snprintf at the precision that reads back to the same
+ * number. Other types fall back to their stream operators.
+ *
+ * A text is read into one buffer and split into pieces of whole lines, which are counted and
+ * then parsed independently, so both passes can run on several threads.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * Throws std :: runtime_error when a file cannot be opened or is not a matrix text.
+ ********************************************************************************/
+
+#ifndef MATRIX_TEXT_H
+#define MATRIX_TEXT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "BFloat16.h"
+
+/*
+ * @def TEXT_PIECE
+ * @brief bytes of text in a piece parsed by one thread at a time
+ */
+#define TEXT_PIECE (1 << 20)
+
+/*
+ * @def TEXT_PIECE_CELLS
+ * @brief cells written to a buffer by one thread at a time
+ */
+#define TEXT_PIECE_CELLS (1 << 16)
+
+/*
+ * @def OPEN_TEXT_MESSAGE
+ * @brief print message for a text file that cannot be read
+ */
+#define OPEN_TEXT_MESSAGE "Cannot read matrix text: "
+
+/*
+ * @def BAD_TEXT_MESSAGE
+ * @brief print message for a text that is not a matrix
+ */
+#define BAD_TEXT_MESSAGE "Not a valid matrix text: "
+
+/**
+ * @brief Checks whether a character separates cells
+ * @param the character
+ * @return true for a tab, space, comma or carriage return, false otherwise
+ */
+inline bool isTextSeparator(char c)
+{
+	return c == '\t' || c == ' ' || c == ',' || c == '\r';
+}
+
+/**
+ * @brief Checks whether a character ends a cell
+ * @param the character
+ * @return true for a separator, a newline or the end of the text, false otherwise
+ */
+inline bool isTextCellEnd(char c)
+{
+	return isTextSeparator(c) || c == '\n' || c == '\0';
+}
+
+/**
+ * @brief Reads and writes cells of a type through its stream operators
+ */
+template <typename T, typename Enable = void>
+struct MatrixTextCodec
+{
+	/**
+	 * @brief Parses a cell
+	 * @param first character of the cell
+	 * @param the cell to set
+	 * @return one past the last character of the cell, nullptr if it is not a T
+	 */
+	static const char *parse(const char *cursor, T& cell)
+	{
+		const char *end = cursor;
+		while(!isTextCellEnd(*end))
+		{
+			++end;
+		}
+		std :: istringstream in(std :: string(cursor, end));
+		return (in >> cell) && in.peek() == EOF ? end : nullptr;
+	}
+
+	/**
+	 * @brief Appends a cell to a buffer
+	 * @param the buffer
+	 * @param the cell
+	 */
+	static void format(std :: string& out, const T& cell)
+	{
+		std :: ostringstream text;
+		text << cell;
+		out += text.str();
+	}
+};
+
+/**
+ * @brief Reads and writes integers digit by digit
+ */
+template <typename T>
+struct MatrixTextCodec<T, typename std :: enable_if<std :: is_integral<T> :: value>::type>
+{
+	/**
+	 * @see MatrixTextCodec :: parse
+	 */
+	static const char *parse(const char *cursor, T& cell)
+	{
+		const bool negative = *cursor == '-';
+		if(negative || *cursor == '+')
+		{
+			++cursor;
+		}
+		if(*cursor < '0' || *cursor > '9')
+		{
+			return nullptr;
+		}
+		// the magnitude of the most negative number is one more than the largest
+		unsigned long long limit = std :: numeric_limits<T> :: max();
+		if(negative)
+		{
+			limit = std :: is_signed<T> :: value ? limit + 1 : 0;
+		}
+		unsigned long long magnitude = 0;
+		for(; *cursor >= '0' && *cursor <= '9'; ++cursor)
+		{
+			const unsigned int digit = *cursor - '0';
+			if(magnitude > limit / 10 || (magnitude == limit / 10 && digit > limit % 10))
+			{
+				return nullptr;
+			}
+			magnitude = magnitude * 10 + digit;
+		}
+		cell = negative ? (T)(0 - magnitude) : (T)magnitude;
+		return cursor;
+	}
+
+	/**
+	 * @see MatrixTextCodec :: format
+	 */
+	static void format(std :: string& out, T cell)
+	{
+		char digits[24];
+		char *first = digits + sizeof(digits);
+		const bool negative = std :: is_signed<T> :: value && cell < T(0);
+		unsigned long long magnitude = negative ? 0 - (unsigned long long)cell :
+												  (unsigned long long)cell;
+		do
+		{
+			*--first = (char)('0' + magnitude % 10);
+			magnitude /= 10;
+		}
+		while(magnitude);
+		if(negative)
+		{
+			*--first = '-';
+		}
+		out.append(first, digits + sizeof(digits));
+	}
+};
+
+/**
+ * @brief Reads floating point numbers with strtod and writes them with the digits that read
+ * back to the same number
+ */
+template <typename T>
+struct MatrixTextCodec<T, typename std :: enable_if<std :: is_floating_point<T> :: value>::type>
+{
+	/**
+	 * @see MatrixTextCodec :: parse
+	 */
+	static const char *parse(const char *cursor, T& cell)
+	{
+		char *end;
+		cell = _convert(cursor, &end, (T *)nullptr);
+		return end == cursor ? nullptr : end;
+	}
+
+	/**
+	 * @see MatrixTextCodec :: format
+	 */
+	static void format(std :: string& out, T cell)
+	{
+		char digits[64];
+		const int precision = std :: numeric_limits<T> :: max_digits10;
+		// long double formatting is much slower, only numbers that need it take it
+		const int length = std :: is_same<T, long double> :: value ?
+						   std :: snprintf(digits, sizeof(digits), "%.*Lg", precision,
+										   (long double)cell) :
+						   std :: snprintf(digits, sizeof(digits), "%.*g", precision, (double)cell);
+		out.append(digits, length);
+	}
+
+private:
+
+	/**
+	 * @brief strtod at the precision of T
+	 * @param first character of the number
+	 * @param set to one past the last character of the number
+	 * @param tag selecting the precision
+	 * @return the number
+	 */
+	static float _convert(const char *cursor, char **end, float *)
+	{
+		return std :: strtof(cursor, end);
+	}
+
+	static double _convert(const char *cursor, char **end, double *)
+	{
+		return std :: strtod(cursor, end);
+	}
+
+	static long double _convert(const char *cursor, char **end, long double *)
+	{
+		return std :: strtold(cursor, end);
+	}
+};
+
+/**
+ * @brief Reads BFloat16 numbers as floats and writes them with the digits that read back to the
+ * same BFloat16
+ */
+template <>
+struct MatrixTextCodec<BFloat16>
+{
+	/**
+	 * @see MatrixTextCodec :: parse
+	 */
+	static const char *parse(const char *cursor, BFloat16& cell)
+	{
+		char *end;
+		cell = BFloat16(std :: strtof(cursor, &end));
+		return end == cursor ? nullptr : end;
+	}
+
+	/**
+	 * @see MatrixTextCodec :: format
+	 */
+	static void format(std :: string& out, BFloat16 cell)
+	{
+		char digits[32];
+		out.append(digits, std :: snprintf(digits, sizeof(digits), "%.4g", (double)(float)cell));
+	}
+};
+
+/**
+ * @brief Reads a whole text file into a buffer ending with a '\0', which stops the parsers of
+ * the last cell
+ * @param path of the file
+ * @return the buffer
+ */
+inline std :: vector<char> readMatrixText(const std :: string& path)
+{
+	std :: ifstream in(path.c_str(), std :: ios :: binary | std :: ios :: ate);
+	if(!in)
+	{
+		throw std :: runtime_error(OPEN_TEXT_MESSAGE + path);
+	}
+	std :: vector<char> text((size_t)in.tellg() + 1, '\0');
+	in.seekg(0);
+	if(!in.read(text.data(), text.size() - 1))
+	{
+		throw std :: runtime_error(OPEN_TEXT_MESSAGE + path);
+	}
+	return text;
+}
+
+/**
+ * @brief Splits a text into pieces of whole lines of about TEXT_PIECE bytes
+ * @param first character of the text
+ * @param one past the last character of the text
+ * @return the starts of the pieces followed by the end of the text
+ */
+inline std :: vector<const char *> splitMatrixText(const char *begin, const char *end)
+{
+	std :: vector<const char *> pieces(1, begin);
+	while(end - pieces.back() > TEXT_PIECE)
+	{
+		const char *cut = pieces.back() + TEXT_PIECE;
+		while(cut < end && *cut != '\n')
+		{
+			++cut;
+		}
+		if(cut == end)
+		{
+			break;
+		}
+		pieces.push_back(cut + 1);
+	}
+	pieces.push_back(end);
+	return pieces;
+}
+
+/**
+ * @brief Skips a line that only holds separators
+ * @param first character of a line, moved past it if it is blank
+ * @return true if the line was blank, false otherwise
+ */
+inline bool skipBlankTextLine(const char *& cursor)
+{
+	const char *end = cursor;
+	while(isTextSeparator(*end))
+	{
+		++end;
+	}
+	if(*end != '\n' && *end != '\0')
+	{
+		return false;
+	}
+	cursor = *end == '\n' ? end + 1 : end;
+	return true;
+}
+
+/**
+ * @brief Counts the lines of a piece of text that are not blank
+ * @param first character of the piece
+ * @param one past the last character of the piece
+ * @return the number of rows
+ */
+inline size_t countTextRows(const char *begin, const char *end)
+{
+	size_t rowAmnt = 0;
+	while(begin < end)
+	{
+		if(!skipBlankTextLine(begin))
+		{
+			++rowAmnt;
+			while(begin < end && *begin++ != '\n')
+			{
+			}
+		}
+	}
+	return rowAmnt;
+}
+
+/**
+ * @brief Counts the cells of a line
+ * @param first character of the line
+ * @return the number of cells
+ */
+inline size_t countTextCells(const char *cursor)
+{
+	size_t cellAmnt = 0;
+	while(*cursor != '\n' && *cursor != '\0')
+	{
+		if(isTextSeparator(*cursor))
+		{
+			++cursor;
+			continue;
+		}
+		++cellAmnt;
+		while(!isTextCellEnd(*cursor))
+		{
+			++cursor;
+		}
+	}
+	return cellAmnt;
+}
+
+/**
+ * @brief Parses a line that is not blank into a row of cells
+ * @param first character of the line, moved to the start of the next line
+ * @param the cells of the row
+ * @param number of cells the row must have
+ * @return true if the line held exactly that many cells, false otherwise
+ */
+template <typename T>
+bool parseTextRow(const char *& cursor, T *cells, size_t colAmnt)
+{
+	size_t col = 0;
+	while(*cursor != '\n' && *cursor != '\0')
+	{
+		if(isTextSeparator(*cursor))
+		{
+			++cursor;
+			continue;
+		}
+		if(col == colAmnt)
+		{
+			return false;
+		}
+		cursor = MatrixTextCodec<T> :: parse(cursor, cells[col++]);
+		if(cursor == nullptr || !isTextCellEnd(*cursor))
+		{
+			return false;
+		}
+	}
+	if(*cursor == '\n')
+	{
+		++cursor;
+	}
+	return col == colAmnt;
+}
+
+#endif
@@ -0,0 +1,252 @@
+/********************************************************************************
+ * @file MatrixTrace.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix tracing header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix tracing header.
+ *
+ * Opt in instrumentation of the Matrix operations. When the program is compiled with
+ * -DMATRIX_TRACE every operation records its wall time, the bytes it touched, the number of
+ * threads it used and the number of matrices it allocated, and every chunk of rows run on the
+ * pool records which thread ran it. The recorded events can be written in the Chrome trace event
+ * format and opened in chrome://tracing or Perfetto.
+ *
+ * Without MATRIX_TRACE the MATRIX_TRACE_* macros expand to nothing, so tracing costs nothing.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * None, recording never throws out of an operation. An event that cannot be stored is dropped
+ * and counted.
+ ********************************************************************************/
+
+#ifndef MATRIX_TRACE_H
+#define MATRIX_TRACE_H
+
+#ifdef MATRIX_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One traced operation or chunk
+ */
+struct MatrixTraceEvent
+{
+	const char *name; /**< Name of the operation, a string literal. */
+	long long start; /**< Start in microseconds since the tracer was created. */
+	long long duration; /**< Duration in microseconds. */
+	unsigned int thread; /**< Small id of the thread that ran it. */
+	unsigned int rows; /**< Row dimension of the result, or first row of a chunk. */
+	unsigned int cols; /**< Column dimension of the result, or one past the last row of a chunk. */
+	size_t bytes; /**< Bytes read and written. */
+	unsigned int threads; /**< Threads the operation was split between. */
+	unsigned int allocations; /**< Matrices allocated by the operation on its own thread. */
+};
+
+/**
+ * @brief Collects the events of all threads
+ */
+class MatrixTracer
+{
+public:
+
+	/**
+	 * @brief Getter for the tracer of the program
+	 * @return the tracer
+	 */
+	static MatrixTracer& instance()
+	{
+		static MatrixTracer tracer;
+		return tracer;
+	}
+
+	/**
+	 * @brief Small sequential id of the calling thread, stable for the life of the thread
+	 * @return the id
+	 */
+	static unsigned int threadId()
+	{
+		static std :: atomic<unsigned int> nextId(0);
+		thread_local unsigned int id = nextId++;
+		return id;
+	}
+
+	/**
+	 * @brief Number of matrices allocated by the calling thread so far
+	 * @return reference to the counter of the calling thread
+	 */
+	static unsigned int& allocations()
+	{
+		thread_local unsigned int count = 0;
+		return count;
+	}
+
+	/**
+	 * @brief Microseconds since the tracer was created
+	 * @return the time
+	 */
+	long long now() const
+	{
+		return std :: chrono :: duration_cast<std :: chrono :: microseconds>(
+			std :: chrono :: steady_clock :: now() - _origin).count();
+	}
+
+	/**
+	 * @brief Adds an event. Called from destructors, so an event that cannot be stored is
+	 * dropped instead of throwing.
+	 * @param the event
+	 */
+	void record(const MatrixTraceEvent& event) noexcept
+	{
+		try
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			_events.push_back(event);
+		}
+		catch (...)
+		{
+			++_dropped;
+		}
+	}
+
+	/**
+	 * @brief Getter for the number of events dropped because they could not be stored
+	 * @return the dropped events
+	 */
+	size_t dropped() const
+	{
+		return _dropped;
+	}
+
+	/**
+	 * @brief Getter for a copy of the events recorded so far
+	 * @return the events
+	 */
+	std :: vector<MatrixTraceEvent> events() const
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		return _events;
+	}
+
+	/**
+	 * @brief Drops all the events recorded so far
+	 */
+	void clear()
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		_events.clear();
+		_dropped = 0;
+	}
+
+	/**
+	 * @brief Writes the events in the Chrome trace event JSON format
+	 * @param stream to write to
+	 */
+	void writeChromeTrace(std :: ostream& os) const
+	{
+		std :: vector<MatrixTraceEvent> recorded = events();
+		os << "{\"traceEvents\":[\n";
+		for(size_t i = 0; i < recorded.size(); ++i)
+		{
+			const MatrixTraceEvent& event = recorded[i];
+			os << "{\"name\":\"" << event.name << "\",\"cat\":\"matrix\",\"ph\":\"X\",\"pid\":1"
+			   << ",\"tid\":" << event.thread << ",\"ts\":" << event.start << ",\"dur\":"
+			   << event.duration << ",\"args\":{\"rows\":" << event.rows << ",\"cols\":"
+			   << event.cols << ",\"bytes\":" << event.bytes << ",\"threads\":" << event.threads
+			   << ",\"allocations\":" << event.allocations << "}}"
+			   << (i + 1 < recorded.size() ? ",\n" : "\n");
+		}
+		os << "],\"displayTimeUnit\":\"ms\"}\n";
+	}
+
+private:
+
+	MatrixTracer() : _origin(std :: chrono :: steady_clock :: now()), _dropped(0)
+	{
+	}
+
+	std :: chrono :: steady_clock :: time_point _origin; /**< Time zero of the trace. */
+	mutable std :: mutex _mutex; /**< Guards _events. */
+	std :: vector<MatrixTraceEvent> _events; /**< The recorded events. */
+	std :: atomic<size_t> _dropped; /**< Events that could not be stored. */
+};
+
+/**
+ * @brief Records an event covering its own lifetime
+ */
+class MatrixTraceScope
+{
+public:
+
+	/**
+	 * @brief Starts timing an operation
+	 * @param name of the operation, a string literal
+	 * @param row dimension of the result
+	 * @param column dimension of the result
+	 * @param bytes read and written
+	 * @param threads the operation is split between
+	 */
+	MatrixTraceScope(const char *name, unsigned int rowAmnt, unsigned int colAmnt, size_t bytes,
+					 unsigned int threads)
+	{
+		_event.name = name;
+		_event.rows = rowAmnt;
+		_event.cols = colAmnt;
+		_event.bytes = bytes;
+		_event.threads = threads;
+		_event.thread = MatrixTracer :: threadId();
+		_allocationsBefore = MatrixTracer :: allocations();
+		_event.start = MatrixTracer :: instance().now();
+	}
+
+	/**
+	 * @brief Stops timing and records the event
+	 */
+	~MatrixTraceScope()
+	{
+		_event.duration = MatrixTracer :: instance().now() - _event.start;
+		_event.allocations = MatrixTracer :: allocations() - _allocationsBefore;
+		MatrixTracer :: instance().record(_event);
+	}
+
+	MatrixTraceScope(const MatrixTraceScope&) = delete;
+	MatrixTraceScope& operator=(const MatrixTraceScope&) = delete;
+
+private:
+
+	MatrixTraceEvent _event; /**< The event being timed. */
+	unsigned int _allocationsBefore; /**< Allocation count of the thread at the start. */
+};
+
+/*
+ * @def MATRIX_TRACE_SCOPE
+ * @brief times the rest of the enclosing block as an event
+ */
+#define MATRIX_TRACE_SCOPE(name, rowAmnt, colAmnt, bytes, threads) \
+	MatrixTraceScope matrixTraceScope(name, rowAmnt, colAmnt, bytes, threads)
+
+/*
+ * @def MATRIX_TRACE_ALLOC
+ * @brief counts an allocation of a matrix on the calling thread
+ */
+#define MATRIX_TRACE_ALLOC() (++MatrixTracer :: allocations())
+
+#else
+
+#define MATRIX_TRACE_SCOPE(name, rowAmnt, colAmnt, bytes, threads)
+#define MATRIX_TRACE_ALLOC()
+
+#endif
+
+#endif
@@ -0,0 +1,184 @@
+/********************************************************************************
+ * @file MatrixTuner.hpp
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix auto tuner header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix auto tuner.
+ *
+ * Runs a short calibration sweep of the Matrix kernels of an element type on the current machine
+ * and stores the best parameters in MatrixTuning, which can then be saved as a profile:
+ *  - the tile sizes of the blocked multiplication and transpose
+ *  - the number of threads that runs the parallel add and multiply the fastest
+ *  - the crossover, the amount of work from which the parallel add and multiply beat the
+ *    sequential ones
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * None, the sweep only uses dimensions that are valid for every operation it times.
+ ********************************************************************************/
+
+#ifndef MATRIX_TUNER_H
+#define MATRIX_TUNER_H
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <ostream>
+#include <vector>
+#include "Matrix.hpp"
+#include "MatrixTuning.h"
+#include "ThreadPool.h"
+
+/*
+ * @def TUNE_REPS
+ * @brief times every candidate is run, the median is kept
+ */
+#define TUNE_REPS 3
+
+/*
+ * @def TUNE_MULTIPLY_SIZE
+ * @brief dimension the multiplication is tuned at
+ */
+#define TUNE_MULTIPLY_SIZE 256
+
+/*
+ * @def TUNE_STREAM_SIZE
+ * @brief dimension the addition and transpose are tuned at
+ */
+#define TUNE_STREAM_SIZE 1024
+
+/**
+ * @brief Median time of a few runs of an operation
+ * @param callable running the operation once
+ * @return the median in seconds
+ */
+template <typename F>
+double tuneTime(F operation)
+{
+	std :: vector<double> times;
+	for(int i = 0; i < TUNE_REPS; ++i)
+	{
+		std :: chrono :: steady_clock :: time_point begin = std :: chrono :: steady_clock :: now();
+		operation();
+		times.push_back(std :: chrono :: duration<double>(std :: chrono :: steady_clock :: now() -
+														  begin).count());
+	}
+	std :: sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+/**
+ * @brief Picks the candidate value of a parameter that runs an operation the fastest
+ * @param the parameter to set to each candidate, left at the best one
+ * @param candidates
+ * @param callable running the operation once
+ */
+template <typename P, typename F>
+void tuneParameter(P& parameter, const std :: vector<P>& candidates, F operation)
+{
+	double best = std :: numeric_limits<double> :: max();
+	P bestValue = parameter;
+	for(size_t i = 0; i < candidates.size(); ++i)
+	{
+		parameter = candidates[i];
+		double time = tuneTime(operation);
+		if(time < best)
+		{
+			best = time;
+			bestValue = candidates[i];
+		}
+	}
+	parameter = bestValue;
+}
+
+/**
+ * @brief Finds the amount of work from which the parallel run of an operation beats the
+ * sequential one at every larger size swept
+ * @param the parameters of the kernel, threshold is set to the crossover
+ * @param callable building the operands of a size and returning the operation on them
+ * @param largest dimension to sweep
+ * @param work of a square operation of a dimension
+ */
+template <typename T, typename MakeOperation, typename Work>
+void tuneCrossover(MatrixKernelTuning& tuning, MakeOperation makeOperation,
+				   unsigned int largest, Work work)
+{
+	size_t crossover = std :: numeric_limits<size_t> :: max();
+	tuning.threshold = 0;
+	for(unsigned int size = largest; size >= 2; size /= 2)
+	{
+		auto operation = makeOperation(size);
+		Matrix<T> :: setParallel(false);
+		double sequential = tuneTime(operation);
+		Matrix<T> :: setParallel(true);
+		double parallel = tuneTime(operation);
+		// sweep down from the largest size and stop at the first size parallel loses at
+		if(parallel >= sequential)
+		{
+			break;
+		}
+		crossover = work(size);
+	}
+	tuning.threshold = crossover;
+}
+
+/**
+ * @brief Tunes every kernel of an element type and stores the parameters in MatrixTuning
+ * @param stream to log the chosen parameters to
+ */
+template <typename T>
+void tuneMatrix(std :: ostream& log)
+{
+	MatrixTuning& tuning = MatrixTuning :: instance();
+	MatrixKernelTuning& add = tuning.kernel<T>(KERNEL_ADD);
+	MatrixKernelTuning& multiply = tuning.kernel<T>(KERNEL_MULTIPLY);
+	MatrixKernelTuning& trans = tuning.kernel<T>(KERNEL_TRANS);
+	std :: vector<unsigned int> tiles = {8, 16, 32, 64, 128, 256};
+
+	Matrix<T> square(TUNE_MULTIPLY_SIZE, TUNE_MULTIPLY_SIZE);
+	Matrix<T> big(TUNE_STREAM_SIZE, TUNE_STREAM_SIZE);
+
+	// tiles are a property of the caches of one core, tune them sequentially
+	Matrix<T> :: setParallel(false);
+	tuneParameter(multiply.tile, tiles, [&]() { return square * square; });
+	tuneParameter(trans.tile, tiles, [&]() { return big.trans(); });
+
+	// then the most threads worth using at the tuned sizes, with every size running in parallel
+	std :: vector<unsigned int> threads;
+	for(unsigned int amount = 1; amount < ThreadPool :: shared().size() + 1; amount *= 2)
+	{
+		threads.push_back(amount);
+	}
+	threads.push_back(ThreadPool :: shared().size() + 1);
+	Matrix<T> :: setParallel(true);
+	multiply.threshold = 0;
+	add.threshold = 0;
+	tuneParameter(multiply.threads, threads, [&]() { return square * square; });
+	tuneParameter(add.threads, threads, [&]() { return big + big; });
+
+	// and last the crossover from which running in parallel pays off
+	tuneCrossover<T>(multiply, [](unsigned int size)
+	{
+		Matrix<T> operand(size, size);
+		return [operand]() { return operand * operand; };
+	}, TUNE_MULTIPLY_SIZE, [](unsigned int size) { return (size_t)size * size * size; });
+	tuneCrossover<T>(add, [](unsigned int size)
+	{
+		Matrix<T> operand(size, size);
+		return [operand]() { return operand + operand; };
+	}, TUNE_STREAM_SIZE, [](unsigned int size) { return (size_t)size * size; });
+
+	log << MatrixTuning :: typeName<T>() << ": multiply tile " << multiply.tile << " threads "
+		<< multiply.threads << " threshold " << multiply.threshold << ", add threads "
+		<< add.threads << " threshold " << add.threshold << ", trans tile " << trans.tile
+		<< std :: endl;
+}
+
+#endif
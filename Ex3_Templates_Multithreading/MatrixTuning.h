@@ -0,0 +1,220 @@
+/********************************************************************************
+ * @file MatrixTuning.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard Matrix tuning header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard Matrix tuning header.
+ *
+ * Holds the machine dependent parameters of the Matrix kernels for every element type: the tile
+ * size of the blocked kernels, the amount of work from which running in parallel pays off and
+ * the number of threads to split a kernel between.
+ *
+ * The parameters are read once at startup from the profile file named by the MATRIX_PROFILE
+ * environment variable, or from matrix_profile.txt in the working directory. A profile is made by
+ * the calibration sweep of MatrixTuner.hpp (MatrixBenchmark -t). Every line of a profile is
+ *     <type> <kernel> <tile> <threshold> <threads>
+ * and lines starting with # are comments.
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * A missing profile leaves the defaults in place, lines that cannot be parsed are skipped.
+ ********************************************************************************/
+
+#ifndef MATRIX_TUNING_H
+#define MATRIX_TUNING_H
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "MatrixFile.h"
+
+/*
+ * @def PROFILE_ENV
+ * @brief environment variable holding the path of the profile
+ */
+#define PROFILE_ENV "MATRIX_PROFILE"
+
+/*
+ * @def DEF_PROFILE
+ * @brief profile read when PROFILE_ENV is not set
+ */
+#define DEF_PROFILE "matrix_profile.txt"
+
+/*
+ * @def DEF_TILE
+ * @brief tile size used when no profile says otherwise
+ */
+#define DEF_TILE 64
+
+/**
+ * @brief The kernels that have parameters
+ */
+enum MatrixKernel
+{
+	KERNEL_ADD,
+	KERNEL_MULTIPLY,
+	KERNEL_TRANS,
+	KERNELS
+};
+
+/**
+ * @brief Parameters of one kernel for one element type
+ */
+struct MatrixKernelTuning
+{
+	MatrixKernelTuning() : tile(DEF_TILE), threshold(0), threads(0)
+	{
+	}
+
+	unsigned int tile; /**< Side of the square blocks of a blocked kernel. */
+	size_t threshold; /**< Cell operations from which parallel mode uses the pool. */
+	unsigned int threads; /**< Most threads to split the kernel between, 0 for all. */
+};
+
+/**
+ * @brief The parameters of every kernel for every element type
+ */
+class MatrixTuning
+{
+public:
+
+	/**
+	 * @brief Getter for the parameters of the program, loading the profile on first use
+	 * @return the parameters
+	 */
+	static MatrixTuning& instance()
+	{
+		static MatrixTuning tuning;
+		return tuning;
+	}
+
+	/**
+	 * @brief Name an element type has in a profile
+	 * @return the name
+	 */
+	template <typename T>
+	static const char *typeName()
+	{
+		static const char *names[] = {"generic", "int8", "uint8", "int16", "uint16", "int32",
+									  "uint32", "int64", "uint64", "float", "double", "complex"};
+		return names[MatrixDataTypeOf<T> :: value];
+	}
+
+	/**
+	 * @brief Getter for the parameters of a kernel for an element type. The reference stays
+	 * valid for the life of the program.
+	 * @param the kernel
+	 * @return its parameters
+	 */
+	template <typename T>
+	MatrixKernelTuning& kernel(MatrixKernel which)
+	{
+		static MatrixKernelTuning *table = _table(typeName<T>());
+		return table[which];
+	}
+
+	/**
+	 * @brief Reads a profile over the current parameters
+	 * @param path of the profile
+	 * @return true if the file was read, false if it could not be opened
+	 */
+	bool load(const std :: string& path)
+	{
+		std :: ifstream in(path.c_str());
+		if(!in)
+		{
+			return false;
+		}
+		std :: string line;
+		while(std :: getline(in, line))
+		{
+			std :: stringstream stream(line);
+			std :: string type, name;
+			MatrixKernelTuning tuning;
+			if(line.empty() || line[0] == '#' ||
+			   !(stream >> type >> name >> tuning.tile >> tuning.threshold >> tuning.threads))
+			{
+				continue;
+			}
+			for(int i = 0; i < KERNELS; ++i)
+			{
+				if(name == _kernelNames()[i])
+				{
+					_table(type)[i] = tuning;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Writes the current parameters as a profile
+	 * @param path of the profile
+	 * @return true if the file was written, false otherwise
+	 */
+	bool save(const std :: string& path) const
+	{
+		std :: ofstream out(path.c_str());
+		out << "# <type> <kernel> <tile> <threshold> <threads>" << std :: endl;
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		for(std :: map<std :: string, _Entry> :: const_iterator it = _types.begin();
+			it != _types.end(); ++it)
+		{
+			for(int i = 0; i < KERNELS; ++i)
+			{
+				const MatrixKernelTuning& tuning = it->second.kernels[i];
+				out << it->first << " " << _kernelNames()[i] << " " << tuning.tile << " "
+					<< tuning.threshold << " " << tuning.threads << std :: endl;
+			}
+		}
+		return static_cast<bool>(out);
+	}
+
+private:
+
+	/**
+	 * @brief Parameters of all the kernels of one type
+	 */
+	struct _Entry
+	{
+		MatrixKernelTuning kernels[KERNELS]; /**< By MatrixKernel. */
+	};
+
+	MatrixTuning()
+	{
+		const char *path = std :: getenv(PROFILE_ENV);
+		load(path != nullptr ? path : DEF_PROFILE);
+	}
+
+	static const char * const *_kernelNames()
+	{
+		static const char * const names[] = {"add", "multiply", "trans"};
+		return names;
+	}
+
+	/**
+	 * @brief Getter for the kernels of a type, created with the defaults on first use. Entries of
+	 * a std :: map never move, so the pointer stays valid. The first use of two types may come
+	 * from two threads at once, so the map is only touched under the lock.
+	 */
+	MatrixKernelTuning *_table(const std :: string& type)
+	{
+		std :: lock_guard<std :: mutex> lock(_mutex);
+		return _types[type].kernels;
+	}
+
+	mutable std :: mutex _mutex; /**< Guards the entries of _types, not the parameters. */
+	std :: map<std :: string, _Entry> _types; /**< Parameters by type name. */
+};
+
+#endif
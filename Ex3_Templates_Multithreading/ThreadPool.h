@@ -0,0 +1,532 @@
+/********************************************************************************
+ * @file ThreadPool.h
+ * @author  Dan Kufra
+ * @version 1.0
+ * @date 25.08.2015
+ *
+ * @brief The SLabCPP Standard ThreadPool header file.
+ *
+ * @section LICENSE
+ * This program is not a free software;
+ *
+ * @section DESCRIPTION
+ * The LabCPP Standard ThreadPool header.
+ *
+ * This header provides a fixed size pool of worker threads shared by all the matrices of the
+ * program, so operations do not pay for creating a thread per row.
+ *
+ * The header provides the following features:
+ *  - submitting tasks to run on any worker or on one given worker
+ *  - splitting a range of indexes between the workers and the calling thread
+ *  - pinning the workers to cores, packed onto as few NUMA nodes as possible (compact) or dealt
+ *    round robin between the nodes (spread), chosen with the MATRIX_PLACEMENT environment variable
+ *    or with pin()
+ *  - splitting a range into one fixed block per worker, so a loop over the same range always
+ *    hands the same indexes to the same pinned worker and the memory it first touched stays on
+ *    its node
+ *
+ * Error handling
+ * ~~~~~~~~~~~~~~
+ * An exception thrown by one chunk of a parallel loop is rethrown to the caller of the loop.
+ ********************************************************************************/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * @def PLACEMENT_ENV
+ * @brief environment variable choosing the placement of the shared pool, compact or spread
+ */
+#define PLACEMENT_ENV "MATRIX_PLACEMENT"
+
+/*
+ * @def NODE_PATH
+ * @brief sysfs directory describing the NUMA nodes
+ */
+#define NODE_PATH "/sys/devices/system/node/"
+
+/**
+ * @brief Where the workers of a pool run
+ */
+enum ThreadPlacement
+{
+	PLACEMENT_NONE, /**< Anywhere the scheduler likes, loops balance chunks dynamically. */
+	PLACEMENT_COMPACT, /**< Pinned filling one NUMA node before the next. */
+	PLACEMENT_SPREAD /**< Pinned round robin between the NUMA nodes. */
+};
+
+/**
+ * @brief A fixed size pool of worker threads running submitted tasks in order.
+ */
+class ThreadPool
+{
+public:
+
+	/**
+	 * @brief Getter for the pool shared by all matrices, created on first use with a worker for
+	 * every hardware thread.
+	 * @return the shared pool
+	 */
+	static ThreadPool& shared()
+	{
+		static ThreadPool pool(std :: max(1u, std :: thread :: hardware_concurrency()),
+							   _placementFromEnv());
+		return pool;
+	}
+
+	/**
+	 * @brief Constructor that starts the workers
+	 * @param number of workers
+	 * @param where to run the workers
+	 */
+	explicit ThreadPool(unsigned int threadAmnt, ThreadPlacement placement = PLACEMENT_NONE) :
+		_own(threadAmnt), _stopping(false), _placement(PLACEMENT_NONE)
+	{
+		for(unsigned int i = 0; i < threadAmnt; ++i)
+		{
+			_workers.push_back(std :: thread(&ThreadPool :: _work, this, i));
+		}
+		if(placement != PLACEMENT_NONE)
+		{
+			pin(placement);
+		}
+	}
+
+	/**
+	 * @brief Destructor that lets the workers finish the queued tasks and joins them
+	 */
+	~ThreadPool()
+	{
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_wakeUp.notify_all();
+		for(unsigned int i = 0; i < _workers.size(); ++i)
+		{
+			_workers[i].join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Getter for the number of workers
+	 * @return number of workers
+	 */
+	unsigned int size() const
+	{
+		return _workers.size();
+	}
+
+	/**
+	 * @brief Queues a task to run on one of the workers
+	 * @param the task
+	 */
+	void submit(std :: function<void()> task)
+	{
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			_tasks.push_back(std :: move(task));
+		}
+		_wakeUp.notify_one();
+	}
+
+	/**
+	 * @brief Queues a task to run on one given worker, before the tasks any worker may run
+	 * @param index of the worker
+	 * @param the task
+	 */
+	void submitTo(unsigned int worker, std :: function<void()> task)
+	{
+		{
+			std :: lock_guard<std :: mutex> lock(_mutex);
+			_own[worker].push_back(std :: move(task));
+		}
+		// only the right worker may take it, so wake them all
+		_wakeUp.notify_all();
+	}
+
+	/**
+	 * @brief Getter for where the workers run
+	 * @return the placement
+	 */
+	ThreadPlacement placement() const
+	{
+		return static_cast<ThreadPlacement>(_placement.load());
+	}
+
+	/**
+	 * @brief Pins every worker to a core of the process following a placement, or unpins them.
+	 * Worker i runs on the i-th core of the order of the placement, wrapping around when there
+	 * are more workers than cores.
+	 * @param the placement
+	 */
+	void pin(ThreadPlacement placement)
+	{
+		std :: vector<int> order = _cpuOrder(placement);
+		for(unsigned int i = 0; i < _workers.size(); ++i)
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if(placement == PLACEMENT_NONE)
+			{
+				for(size_t cpu = 0; cpu < order.size(); ++cpu)
+				{
+					CPU_SET(order[cpu], &set);
+				}
+			}
+			else
+			{
+				CPU_SET(order[i % order.size()], &set);
+			}
+			pthread_setaffinity_np(_workers[i].native_handle(), sizeof(set), &set);
+		}
+		_placement = placement;
+	}
+
+	/**
+	 * @brief Runs body on every chunk of grain indexes in [begin, end) and returns when all
+	 * chunks are done. The calling thread takes chunks too, so a loop started from inside a
+	 * worker always makes progress even when every other worker is busy.
+	 * @param first index
+	 * @param one past the last index
+	 * @param number of indexes in a chunk
+	 * @param callable receiving the first and one past the last index of a chunk
+	 * @param most threads to run chunks on, counting the calling thread, 0 for all the workers
+	 */
+	template <typename Body>
+	void parallelFor(size_t begin, size_t end, size_t grain, Body body,
+					 unsigned int maxThreads = 0)
+	{
+		if(begin >= end)
+		{
+			return;
+		}
+		grain = std :: max<size_t>(grain, 1);
+		std :: shared_ptr<_Loop> loop = std :: make_shared<_Loop>((end - begin + grain - 1) / grain);
+		auto run = [loop, body, begin, end, grain]()
+		{
+			for(size_t chunk = loop->next++; chunk < loop->chunks; chunk = loop->next++)
+			{
+				size_t first = begin + chunk * grain;
+				try
+				{
+					body(first, std :: min(first + grain, end));
+				}
+				catch (...)
+				{
+					std :: lock_guard<std :: mutex> lock(loop->mutex);
+					if(!loop->error)
+					{
+						loop->error = std :: current_exception();
+					}
+				}
+				if(++loop->done == loop->chunks)
+				{
+					std :: lock_guard<std :: mutex> lock(loop->mutex);
+					loop->finished.notify_all();
+				}
+			}
+		};
+		// no point in waking more workers than there are chunks left for them
+		size_t helpers = std :: min<size_t>(size(), loop->chunks - 1);
+		if(maxThreads > 0)
+		{
+			helpers = std :: min<size_t>(helpers, maxThreads - 1);
+		}
+		for(size_t i = 0; i < helpers; ++i)
+		{
+			submit(run);
+		}
+		run();
+		std :: unique_lock<std :: mutex> lock(loop->mutex);
+		loop->finished.wait(lock, [&loop]() { return loop->done == loop->chunks; });
+		if(loop->error)
+		{
+			std :: rethrow_exception(loop->error);
+		}
+	}
+
+	/**
+	 * @brief Runs body on one contiguous block of [begin, end) per worker and returns when all
+	 * blocks are done. Block i always goes to worker i, so with pinned workers the same indexes of
+	 * every loop over the same range run on the same core. A loop started from inside a worker
+	 * runs the block of that worker itself and then every block no other worker has started yet,
+	 * so it makes progress even when every other worker is busy.
+	 * @param first index
+	 * @param one past the last index
+	 * @param callable receiving the first and one past the last index of a block
+	 * @param most blocks to split the range into, 0 for one per worker
+	 */
+	template <typename Body>
+	void parallelForStatic(size_t begin, size_t end, Body body, unsigned int maxThreads = 0)
+	{
+		if(begin >= end)
+		{
+			return;
+		}
+		size_t blocks = std :: min<size_t>(size(), end - begin);
+		if(maxThreads > 0)
+		{
+			blocks = std :: min<size_t>(blocks, maxThreads);
+		}
+		std :: shared_ptr<_Loop> loop = std :: make_shared<_Loop>(std :: max<size_t>(blocks, 1));
+		auto run = [loop, body, begin, end](size_t block)
+		{
+			if(loop->claimed[block].exchange(true))
+			{
+				return;
+			}
+			size_t span = end - begin;
+			try
+			{
+				body(begin + span * block / loop->chunks, begin + span * (block + 1) / loop->chunks);
+			}
+			catch (...)
+			{
+				std :: lock_guard<std :: mutex> lock(loop->mutex);
+				if(!loop->error)
+				{
+					loop->error = std :: current_exception();
+				}
+			}
+			if(++loop->done == loop->chunks)
+			{
+				std :: lock_guard<std :: mutex> lock(loop->mutex);
+				loop->finished.notify_all();
+			}
+		};
+		const int self = _workerIndex();
+		for(size_t block = 0; block < loop->chunks; ++block)
+		{
+			if((int)block != self)
+			{
+				submitTo(block, [run, block]() { run(block); });
+			}
+		}
+		if(self >= 0)
+		{
+			for(size_t block = 0; block < loop->chunks; ++block)
+			{
+				run(((size_t)self + block) % loop->chunks);
+			}
+		}
+		std :: unique_lock<std :: mutex> lock(loop->mutex);
+		loop->finished.wait(lock, [&loop]() { return loop->done == loop->chunks; });
+		if(loop->error)
+		{
+			std :: rethrow_exception(loop->error);
+		}
+	}
+
+private:
+
+	/**
+	 * @brief Shared bookkeeping of one parallelFor or parallelForStatic call
+	 */
+	struct _Loop
+	{
+		explicit _Loop(size_t chunkAmnt) : chunks(chunkAmnt), next(0), done(0),
+										   claimed(new std :: atomic<bool>[chunkAmnt])
+		{
+			for(size_t i = 0; i < chunks; ++i)
+			{
+				claimed[i] = false;
+			}
+		}
+
+		const size_t chunks; /**< Number of chunks in the loop. */
+		std :: atomic<size_t> next; /**< Next chunk to hand out. */
+		std :: atomic<size_t> done; /**< Number of chunks finished. */
+		std :: mutex mutex; /**< Guards error and finished. */
+		std :: condition_variable finished; /**< Signalled when the last chunk is done. */
+		std :: exception_ptr error; /**< First exception thrown by a chunk. */
+		std :: unique_ptr<std :: atomic<bool>[]> claimed; /**< Blocks started, static loops. */
+	};
+
+	/**
+	 * @brief Index of the worker running the calling thread
+	 * @return the index, -1 when not called from a worker
+	 */
+	static int& _workerIndex()
+	{
+		static thread_local int index = -1;
+		return index;
+	}
+
+	/**
+	 * @brief Reads the placement of the shared pool from PLACEMENT_ENV
+	 * @return the placement, none when unset or unknown
+	 */
+	static ThreadPlacement _placementFromEnv()
+	{
+		const char *value = std :: getenv(PLACEMENT_ENV);
+		if(value != nullptr && std :: strcmp(value, "compact") == 0)
+		{
+			return PLACEMENT_COMPACT;
+		}
+		if(value != nullptr && std :: strcmp(value, "spread") == 0)
+		{
+			return PLACEMENT_SPREAD;
+		}
+		return PLACEMENT_NONE;
+	}
+
+	/**
+	 * @brief Parses a sysfs cpu list such as 0-3,8-11
+	 * @param the list
+	 * @return the cpus in it
+	 */
+	static std :: vector<int> _parseCpuList(const std :: string& list)
+	{
+		std :: vector<int> cpus;
+		std :: stringstream stream(list);
+		std :: string range;
+		while(std :: getline(stream, range, ','))
+		{
+			int first = 0, last = 0;
+			char dash = 0;
+			std :: stringstream bounds(range);
+			if(!(bounds >> first))
+			{
+				continue;
+			}
+			last = (bounds >> dash >> last) ? last : first;
+			for(int cpu = first; cpu <= last; ++cpu)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+
+	/**
+	 * @brief Orders the cores the process may run on for a placement. The cores of every NUMA
+	 * node are read from sysfs, a machine without that information counts as a single node.
+	 * @param the placement
+	 * @return the cores, compact fills a node before the next and spread alternates the nodes
+	 */
+	static std :: vector<int> _cpuOrder(ThreadPlacement placement)
+	{
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		{
+			for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				CPU_SET(cpu, &allowed);
+			}
+		}
+		std :: vector<std :: vector<int>> nodes;
+		std :: string online;
+		std :: ifstream(NODE_PATH "online") >> online;
+		std :: vector<int> nodeIds = _parseCpuList(online);
+		for(size_t i = 0; i < nodeIds.size(); ++i)
+		{
+			std :: string list;
+			std :: stringstream path;
+			path << NODE_PATH "node" << nodeIds[i] << "/cpulist";
+			std :: ifstream(path.str().c_str()) >> list;
+			nodes.push_back(std :: vector<int>());
+			std :: vector<int> cpus = _parseCpuList(list);
+			for(size_t j = 0; j < cpus.size(); ++j)
+			{
+				if(cpus[j] < CPU_SETSIZE && CPU_ISSET(cpus[j], &allowed))
+				{
+					nodes.back().push_back(cpus[j]);
+				}
+			}
+		}
+		size_t widest = 0;
+		for(size_t node = 0; node < nodes.size(); ++node)
+		{
+			widest = std :: max(widest, nodes[node].size());
+		}
+		std :: vector<int> order;
+		for(size_t node = 0; placement != PLACEMENT_SPREAD && node < nodes.size(); ++node)
+		{
+			order.insert(order.end(), nodes[node].begin(), nodes[node].end());
+		}
+		for(size_t depth = 0; placement == PLACEMENT_SPREAD && depth < widest; ++depth)
+		{
+			for(size_t node = 0; node < nodes.size(); ++node)
+			{
+				if(depth < nodes[node].size())
+				{
+					order.push_back(nodes[node][depth]);
+				}
+			}
+		}
+		if(order.empty())
+		{
+			for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if(CPU_ISSET(cpu, &allowed))
+				{
+					order.push_back(cpu);
+				}
+			}
+		}
+		return order;
+	}
+
+	/**
+	 * @brief Main loop of a worker, runs queued tasks until the pool stops. Tasks given to this
+	 * worker come before tasks any worker may run.
+	 * @param index of the worker
+	 */
+	void _work(unsigned int index)
+	{
+		_workerIndex() = index;
+		while(true)
+		{
+			std :: function<void()> task;
+			{
+				std :: unique_lock<std :: mutex> lock(_mutex);
+				_wakeUp.wait(lock, [this, index]()
+				{
+					return _stopping || !_tasks.empty() || !_own[index].empty();
+				});
+				std :: deque<std :: function<void()>>& queue = _own[index].empty() ? _tasks :
+																					  _own[index];
+				if(queue.empty())
+				{
+					return;
+				}
+				task = std :: move(queue.front());
+				queue.pop_front();
+			}
+			task();
+		}
+	}
+
+	std :: vector<std :: thread> _workers; /**< The worker threads. */
+	std :: deque<std :: function<void()>> _tasks; /**< Tasks waiting for any worker. */
+	std :: vector<std :: deque<std :: function<void()>>> _own; /**< Tasks for one worker. */
+	std :: mutex _mutex; /**< Guards _tasks, _own and _stopping. */
+	std :: condition_variable _wakeUp; /**< Signalled when a task is queued or the pool stops. */
+	bool _stopping; /**< Whether the pool is shutting down. */
+	std :: atomic<int> _placement; /**< The ThreadPlacement of the workers. */
+};
+
+#endif